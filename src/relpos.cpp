@@ -22,480 +22,279 @@
                   第一个hhmm为JFoV起始时间
                   第二个hhmm为JFoV结束时间
 
+ 批处理模式: relpos -b <目录或清单文件> 经度方向基准 倾斜方向基准
+ 1) 目录: 处理其中的全部指向文件; 清单: 每行一个指向文件路径
+ 2) 全部文件只解析一次, 按转台分组. 缺省时cam_id前两位为转台编号
+ 3) 每个JFoV文件与同一转台时间重叠最多的FFoV文件配对计算, 结果文件名格式同上
+
+ 流式模式: relpos -s <输入1> [-s <输入2>] 经度方向基准 倾斜方向基准
+ 1) 输入为标准输入(-), 管道或FIFO, 逐行读取交织的JFoV/FFoV记录, 行格式同指向文件
+ 2) 每个转台只保留有限时间窗口内的FFoV历史
+ 3) JFoV的最近FFoV确定后(出现时间超出匹配容差的FFoV记录)立即输出结果到控制台
+ 4) 两个输入中领先的一方暂停读取, 直至另一方赶上, 使两者的时间差保持在窗口内
+
+ 跟踪模式: relpos -f <文件1> <文件2> 经度方向基准 倾斜方向基准
+ 1) 监视文件增长, 只解析新追加的行, 匹配方式同流式模式
+ 2) 结果逐点追加到结果文件, 结果文件名随JFoV结束时间更新, 控制台输出滚动统计
+ 3) Ctrl+C结束跟踪, 输出最终统计结果
+
+ 常驻模式: relpos -d <套接字路径> 经度方向基准 倾斜方向基准
+ 1) 在Unix域套接字(SOCK_SEQPACKET)上接收二进制或文本指向记录, 协议见relpos_daemon.h
+ 2) 匹配方式同流式模式, 结果只保存在内存中
+ 3) 查询应答相机最近的旋转角, 倾斜角, 相对基准值与统计量. Ctrl+C结束服务
+
+ 转台拓扑: relpos -t <拓扑文件> ...
+ 1) 拓扑文件给定各相机的转台, 视场类型和名义基准, 格式见relpos_topology.h
+ 2) 给定拓扑时, 视场类型与转台分组由拓扑确定, 替代上述cam_id规则
+ 3) 拓扑给定名义基准的JFoV使用其名义基准, 其它JFoV使用命令行基准
+
+ sigma裁剪: relpos -c <阈值> ...
+ 1) 适用于单对文件与批处理模式, 阈值为标准差的倍数
+ 2) 旋转角或倾斜角超出裁剪界的数据点被剔除, 迭代至无变化
+ 3) 结果增加剔除标志列(Clip, 1为剔除), 统计结果只包含保留的数据点
+
+ 历史窗口: relpos -w <秒> ...
+ 1) 适用于流式, 跟踪与常驻模式, 缺省为600秒, 不小于匹配容差的2倍
+ 2) 早于最新JFoV时间超过窗口的JFoV记录不再等待FFoV. 确定时没有可用FFoV的
+    JFoV记录数量在结束时输出
+
+ 匹配策略: relpos -m <策略> ...
+ 1) 适用于单对文件与批处理模式, 缺省为nearest
+    nearest : 时间最接近的FFoV数据点
+    previous: 时间不晚于JFoV的最近FFoV数据点
+    next    : 时间不早于JFoV的最近FFoV数据点
+    interp  : 取JFoV时间前后相邻的两个FFoV数据点, 在球面上按时间线性插值(SLERP)得到
+              参考方向, 因此可降低FFoV采样率. 相邻数据点相隔超过60秒时退回nearest
+    knearest: 时间最接近的4个FFoV数据点, 按时间差倒数加权平均方向
+ 2) 除interp外只使用匹配容差(10秒)内的数据点
+ 3) 多个数据点匹配时, 结果中FFoV位置为参考方向, FFoV文件名为权重最大的数据点
+ 4) -i 等同于 -m interp
+
  约束条件:
  1) 望远镜处于跟踪模式
- 2) 文件数据从前到后按照时间顺序
+ 2) 单对文件与批处理模式的文件数据可不按时间顺序(如多台采集主机合并的日志),
+    解析后按时间基数排序; 流式/跟踪/常驻模式的输入须大致按时间顺序到达
+
+ 解析/匹配/变换/统计由librelpos(RelPosSession)完成, 本文件仅为命令行入口
  */
 
 #include <string>
-#include <vector>
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
 #include <string.h>
+#include <signal.h>
+#include "relpos_session.h"
+#include "relpos_batch.h"
+#include "relpos_stream.h"
+#include "relpos_follow.h"
+#include "relpos_daemon.h"
 
 using std::string;
 using std::vector;
 
-//////////////////////////////////////////////////////////////////////////////
-/// 宏定义
-#define API		3.141592653589793
-#define PI360	6.283185307179586
-#define D2R		0.017453292519943		// 使用乘法, 角度转换为弧度的系数
-#define R2D		57.295779513082323		// 使用乘法, 弧度转换为角度的系数
-#define reduce(x, period)	((x) - floor((x) / (period)) * (period))
-
-void Sphere2Cart(double r, double alpha, double beta, double& x, double& y, double& z)
-{
-	x = r * cos(beta) * cos(alpha);
-	y = r * cos(beta) * sin(alpha);
-	z = r * sin(beta);
-}
-
-void Cart2Sphere(double x, double y, double z, double& r, double& alpha, double& beta)
-{
-	r = sqrt(x * x + y * y + z * z);
-	if ((alpha = atan2(y, x)) < 0) alpha += PI360;
-	beta  = atan2(z, sqrt(x * x + y * y));
-}
-
-void RotateForward(double alpha0, double beta0, double& alpha, double& beta)
-{
-	double r = 1.0;
-	double x1, y1, z1;	// 原坐标系投影位置
-	double x2, y2, z2;	// 新坐标系投影位置
-
-	// 在原坐标系的球坐标转换为直角坐标
-	Sphere2Cart(r, alpha, beta, x1, y1, z1);
-	/*! 对直角坐标做旋转变换. 定义矢量V=(alpha0, beta0)
-	 * 主动视角, 旋转矢量V
-	 * 先绕Z轴逆时针旋转: -alpha0, 将矢量V旋转至XZ平面
-	 * 再绕Y轴逆时针旋转: -(PI90 - beta0), 将矢量V旋转至与Z轴重合
-	 **/
-	 x2 = sin(beta0) * cos(alpha0) * x1 + sin(beta0) * sin(alpha0) * y1 - cos(beta0) * z1;
-	 y2 = -sin(alpha0) * x1 + cos(alpha0) * y1;
-	 z2 = cos(beta0) * cos(alpha0) * x1 + cos(beta0) * sin(alpha0) * y1 + sin(beta0) * z1;
-	// 将旋转变换后的直角坐标转换为球坐标, 即以(alpha0, beta0)为极轴的新球坐标系中的位置
-	Cart2Sphere(x2, y2, z2, r, alpha, beta);
-}
-//////////////////////////////////////////////////////////////////////////////
-/// 数据结构
-struct PointRaw {// 原始单数据点
-	double ra, dc;	//< 赤经, 赤纬, 量纲: 角度
-	int ymd;			//< 年月日
-	int hh, mm, ss;	//< 时分秒, 秒量纲: 0.01秒
-	double secs;		//< 秒数
-	string fname;	//< 文件名
-
-public:
-	PointRaw& operator=(const PointRaw& other) {
-		if (this != &other) {
-			ra = other.ra;
-			dc = other.dc;
-			ymd = other.ymd;
-			hh = other.hh;
-			mm = other.mm;
-			ss = other.ss;
-			fname = other.fname;
-		}
-
-		return *this;
-	}
-};
-typedef vector<PointRaw> PtRV;	//< 原始数据点集合
-
-struct PointFile {// 文件数据点
-	string cid;		//< 相机标志
-	PtRV pts;		//< 数据点集合
-
-public:
-	virtual ~PointFile() {
-		pts.clear();
-	}
-};
-
-struct PointCross {// 交叉数据点
-	double ra, dc;	//< JFoV中心位置, 量纲: 角度
-	string fname;	//< JFoV文件名
-	double ra0, dc0;	//< FFoV中心位置, 量纲: 角度
-	string fname0;	//< FFoV文件名
-	double rot, tilt;	//< 旋转角和倾斜角, 量纲: 角度
-
-public:
-	/*!
-	 * @brief 设置数据点, 即JFoV数据
-	 * @param pt 原始数据
-	 */
-	void SetPoint(const PointRaw& pt) {
-		ra = pt.ra;
-		dc = pt.dc;
-		fname = pt.fname;
-	}
-
-	/*!
-	 * @brief 设置参考点, 即FFoV数据
-	 * @param pt 原始数据
-	 */
-	void SetPointRef(const PointRaw& pt) {
-		ra0 = pt.ra;
-		dc0 = pt.dc;
-		fname0 = pt.fname;
-
-		rot = ra * D2R;
-		tilt= dc * D2R;
-		RotateForward(ra0 * D2R, dc0 * D2R, rot, tilt);
-		rot *= R2D;
-		tilt = 90 - tilt * R2D;
-	}
-};
-//////////////////////////////////////////////////////////////////////////////
-/// 全局变量
-string pathSrc1, pathSrc2;	//< 输入文件路径名
-double rot0, tilt0;	//< 旋转与倾斜基准, 量纲: 角度
-PointFile pt_jfov, pt_ffov;	//< JFoV和FFoV的文件数据集合
-bool bjfov, bffov;	//< JFoV和FFoV数据完备标志
-string pathDst; //< 输出文件名
-vector<PointCross> pt_cross;		//< 数据交叉结果
-
-//////////////////////////////////////////////////////////////////////////////
-/// 子函数
 /*!
- * @brief 解析行信息
- * @param line  行信息
- * @param ra    赤经
- * @param dc    赤纬
- * @param fname 文件名
+ * @brief 批处理目录或清单中的全部指向文件
  */
-void ResolveLine(const char* line, double& ra, double& dc, string& fname) {
-	char* token;
-	char seps[] = " \t\r\n";
-	int n = strlen(line);
-	char* buff = new char[n + 1];
-
-	strcpy(buff, line);
-	token = strtok(buff, seps);  ra = atof(token);
-	token = strtok(NULL, seps);  dc = atof(token);
-	token = strtok(NULL, seps);  fname = token;
-	delete []buff;
-}
-
-/*!
- * @brief 解析文件名
- * @param fname  文件名
- * @param cid    相机标志
- * @param ymd    年月日
- * @param hms    时分秒
- */
-void ResolveFilename(const char* fname, string& cid, int& ymd, int& hms) {
-	char* token;
-	char seps[] = "G_T";
-	int pos(0);
-	int n = strlen(fname);
-	char* buff = new char[n - 3];
-	strncpy(buff, fname, n - 4);
-	buff[n - 4] = 0;
-
-	token = strtok(buff, seps);
-	while(token) {
-		switch(++pos) {
-		case 1: // cid
-			cid = token;
-			break;
-		case 2: // obstyp or imgtyp
-			if (strcasecmp(token, "mon") && strcasecmp(token, "toa")) ++pos;
-			break;
-		case 3: // imgtyp
-			break;
-		case 4: // ymd
-			ymd = atoi(token);
-			break;
-		case 5: // hms
-			hms = atoi(token);
-			break;
-		default:
-			break;
-		}
-
-		token = strtok(NULL, seps);
+int RunBatch(int argc, char** argv, const MountTopology& topo, double nsigma, MatchPolicy policy) {
+	RelPosBatch batch;
+	int n;
+	batch.SetTopology(topo);
+	batch.SetClip(nsigma);
+	batch.SetPolicy(policy);
+	batch.SetBase(argc >= 4 ? atof(argv[3]) : 0.0, argc >= 5 ? atof(argv[4]) : 0.0);
+
+	if ((n = batch.AddPath(argv[2])) <= 0) {
+		printf("\n%s<%s>\n", n ? "fail to access path" : "no any file in path", argv[2]);
+		return -2;
+	}
+	if (!batch.Run()) {
+		printf("\nno any data matches condition\n");
 	}
 
-	delete []buff;
-}
-
-/*!
- * @brief 解析文件内容
- * @param filepath 原始文件路径
- * @return
- * 文件解析结果
- */
-bool ResolveFile(const string& filepath) {
 	printf("\n");
 
-	FILE *fp = fopen(filepath.c_str(), "r");
-	if (!fp) return false;
-	printf("---------- Resolving file: %s ----------\n", filepath.c_str());
-
-	char line[200];	// 行缓存区
-	double ra, dc;	// 赤经/赤纬
-	string fname;	// 文件名
-	string cid;		// 相机标志
-	int ymd, hms;	// 时间
-	int hh, mm, ss;	// 时分秒
-	int n(0);
-	PointFile* ptr = NULL;	// 文件数据指针
-	bool* valid;
-
-	while(!feof(fp)) {
-		if (!fgets(line, 200, fp)) continue;
-		ResolveLine(line, ra, dc, fname);
-		ResolveFilename(fname.c_str(), cid, ymd, hms);
-		if (!ptr) {
-			if (atoi(cid.c_str()) % 5 == 0) {
-				ptr = &pt_ffov;
-				valid = &bffov;
-				printf("file<%s> is considered to be from FFoV\n", filepath.c_str());
-			}
-			else {
-				ptr = &pt_jfov;
-				valid = &bjfov;
-				printf("file<%s> is considered to be from JFoV\n", filepath.c_str());
-			}
-			ptr->cid = cid;
-		}
-		ss = hms % 10000;
-		hms /= 10000;
-		mm = hms % 100;
-		hh = hms / 100;
-		++n;
-//		printf("%8.4f %8.4f %s %s %06d %02d %02d %04d\n", ra, dc, fname.c_str(), cid.c_str(), ymd, hh, mm, ss);
-
-		PointRaw pt;
-		pt.ra = ra;
-		pt.dc = dc;
-		pt.fname = fname;
-		pt.ymd = ymd;
-		pt.hh = hh;
-		pt.mm = mm;
-		pt.ss = ss;
-		pt.secs = (hh * 60 + mm) * 60 + ss * 0.01;
-		ptr->pts.push_back(pt);
-	}
-	fclose(fp);
-
-	printf("%d points are resolved from file\n", n);
-	*valid = n > 0;
-	if (ptr == &pt_jfov) {
-		char buff[100];
-		sprintf(buff, "G%s_%02d%02d-%02d%02d.txt", ptr->cid.c_str(),
-				ptr->pts[0].hh, ptr->pts[0].mm,
-				ptr->pts[n - 1].hh, ptr->pts[n - 1].mm);
-		pathDst = buff;
-	}
-
-	return (n > 0);
+	return 0;
 }
 
 /*!
- * @brief 检查JFoV或FFoV时间有效性
- * @return
- * 时间有效性
+ * @brief 流式处理标准输入, 管道或FIFO中的记录
  * @note
- * 有效性判据: 数据日期相同
+ * 结果输出到标准输出, 过程信息输出到标准错误
  */
-bool TimeCheck(const PointFile* ptf) {
-	int n = ptf->pts.size(), i;
-	int ymd = ptf->pts[0].ymd;
-	for (i = 1; i < n && ymd == ptf->pts[i].ymd; ++i);
-	return (i == n);
+int RunStream(int argc, char** argv, const MountTopology& topo, const vector<string>& paths, int window) {
+	RelPosStream stream;
+	stream.SetTopology(topo);
+	stream.SetWindow(window);
+	stream.SetBase(argc >= 2 ? atof(argv[1]) : 0.0, argc >= 3 ? atof(argv[2]) : 0.0);
+
+	if (!stream.Run(paths)) return -2;
+	if (stream.Starved()) fprintf(stderr, "\n%d JFoV records settled without FFoV history\n", stream.Starved());
+	if (!stream.Matched()) fprintf(stderr, "\nno any data matches condition\n");
+	else fprintf(stderr, "\nfound %d matched points\n", stream.Matched());
+
+	return 0;
 }
 
-/*!
- * @brief 检查JFoV和FFoV的时间有效性
- * @return
- * 时间有效性
- * @note
- * 有效性判据: JFoV和FFoV时间范围有交集
- * @note
- * 2017-10-28
- * 为了通用性, 应做更精细判读. 例如: 允许单点数据
- */
-bool TimeCrossCheck() {
-	return (pt_ffov.pts[0].ymd == pt_jfov.pts[0].ymd);
+static RelPosFollow* follow_active = NULL;	// 接收结束信号的跟踪对象
+
+static void StopFollow(int) {
+	if (follow_active) follow_active->Stop();
 }
 
 /*!
- * @brief 从FFoV原始数据中找到与秒数最接近的数据点
- * @param secs JFoV秒数
- * @param from 起始扫描位置
- * @param n    FFoV数据长度
- * @return
- * 匹配数据点位置
- *  -1: 未找到匹配数据
- * >=0: 匹配数据位置
- * @note
- * 匹配条件: 秒数相差不超过10
+ * @brief 跟踪两个增长中的指向文件, 直至收到SIGINT/SIGTERM
  */
-int FindMatchedData(double secs, int from, int n) {
-	PointRaw* pt;
-	int i;
-	double dt0(fabs(secs - pt_ffov.pts[from].secs));
-	double dt1(1E30);
-
-	for (i = from + 1; i < n; ++i) {
-		dt1 = fabs(secs - pt_ffov.pts[i].secs);
-		if (dt1 > dt0) continue;
-		dt0 = dt1;
-		from = i;
-	}
+int RunFollow(int argc, char** argv, const MountTopology& topo, int window) {
+	RelPosFollow follow;
+	vector<string> paths;
+	struct sigaction act;
+
+	paths.push_back(argv[2]);
+	paths.push_back(argv[3]);
+	follow.SetTopology(topo);
+	follow.SetWindow(window);
+	follow.SetBase(argc >= 5 ? atof(argv[4]) : 0.0, argc >= 6 ? atof(argv[5]) : 0.0);
+
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = StopFollow;
+	follow_active = &follow;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+	bool rslt = follow.Follow(paths);
+	follow_active = NULL;
+	if (!rslt) return -2;
+	if (!follow.Matched()) printf("\nno any data matches condition\n");
+	printf("\n");
 
-	return (fabs(secs - pt_ffov.pts[from].secs) > 10.0 ? -1 : from);
+	return 0;
 }
 
-/*!
- * @brief 扫描原始数据并计算相对位置并输出结果
- */
-void ScanData() {
-	printf("\nscan and try to find matched data\n");
-
-	int n1 = pt_jfov.pts.size();
-	int n2 = pt_ffov.pts.size();
-	int i, j(0), k;
-	PointRaw* pt;
-
-	for (i = 0; i < n1; ++i) {
-		pt = &pt_jfov.pts[i];
-		if ((k = FindMatchedData(pt->secs, j, n2)) >= 0) {
-//			j = k;
-
-			PointCross ptc;
-			ptc.SetPoint(*pt);
-			ptc.SetPointRef(pt_ffov.pts[k]);
-			pt_cross.push_back(ptc);
-		}
-	}
+static RelPosDaemon* daemon_active = NULL;	// 接收结束信号的常驻对象
 
-	printf("found %lu matched points\n", pt_cross.size());
+static void StopDaemon(int) {
+	if (daemon_active) daemon_active->Stop();
 }
 
 /*!
- * @brief 输出处理结果到文件
- * @param fp 文件描述符
- * @note
- * fp==stdout或stderr时, 输出到控制台
+ * @brief 在Unix域套接字上服务, 直至收到SIGINT/SIGTERM
  */
-void OutputResult(FILE* fp) {
-	printf("\n");
-	int n = pt_cross.size(), i;
-	PointCross* pt;
-	double drot;
-	if (n == 0) return;
-
-	fprintf(fp, "%8s %8s %33s %8s %8s %33s %5s %4s %6s %5s\n",
-			"R.A.  ", "DEC.  ", "FileName            ",
-			"R.A.0 ", "DEC.0 ", "FileName.0          ",
-			"Rot ", "Tilt", "rRot ", "rTilt");
-	for (i = 0; i < n; ++i) {
-		pt = &pt_cross[i];
-		drot = rot0 - pt->rot;
-		if (drot > 180.0) drot -= 360.0;
-		else if (drot < -180.0) drot += 360.0;
-
-		fprintf(fp, "%8.4f %8.4f %33s %8.4f %8.4f %33s %5.1f %4.1f %6.1f %5.1f\n",
-				pt->ra, pt->dc, pt->fname.c_str(),
-				pt->ra0, pt->dc0, pt->fname0.c_str(),
-				pt->rot, pt->tilt, drot, tilt0 - pt->tilt);
-	}
-
-	if (fp == stdout || fp == stderr) {
-		double rsum(0.0), rsq(0.0), tsum(0.0), tsq(0.0);
-		double rmin(1E30), rmax(-1E30), tmin(1E30), tmax(-1E30);
-		double rmean, rrms, tmean, trms;
-		double rot(pt_cross[0].rot), tilt;
-
-		for (i = 0; i < n; ++i) {
-			pt = &pt_cross[i];
-			tilt = pt->tilt;
-			drot = pt->rot - rot;
-			if (drot > 180.0) rot = pt->rot - 360.0;
-			else if (drot < -180.0) rot = pt->rot + 360.0;
-			else rot = pt->rot;
-
-			if (rmin > rot) rmin = rot;
-			if (rmax < rot) rmax = rot;
-			if (tmin > tilt) tmin = tilt;
-			if (tmax < tilt) tmax = tilt;
-
-			rsum += rot;
-			rsq += (rot * rot);
-			tsum += tilt;
-			tsq += (tilt * tilt);
-		}
+int RunDaemon(int argc, char** argv, const MountTopology& topo, int window) {
+	RelPosDaemon daemon;
+	struct sigaction act;
+
+	daemon.SetTopology(topo);
+	daemon.SetWindow(window);
+	daemon.SetBase(argc >= 4 ? atof(argv[3]) : 0.0, argc >= 5 ? atof(argv[4]) : 0.0);
+
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = StopDaemon;
+	daemon_active = &daemon;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+	bool rslt = daemon.Serve(argv[2]);
+	daemon_active = NULL;
+	if (!rslt) return -2;
+	printf("\nfound %d matched points\n", daemon.Matched());
 
-		rmean = rsum / n;
-		tmean = tsum / n;
-		rrms = sqrt((rsq - rsum * rmean) / n);
-		trms = sqrt((tsq - tsum * tmean) / n);
-		fprintf(fp, "****************************** Statistical results ******************************\n");
-		fprintf(fp, "Rotation Minimum = %6.1f \t Rotation Maximum = %6.1f\n", reduce(rmin, 360.0), reduce(rmax, 360.0));
-		fprintf(fp, "Rotation Mean    = %6.2f \t Rotation Stdev   = %6.2f\n", reduce(rmean, 360.0), rrms);
-		fprintf(fp, "Tilt Minimum     = %6.1f \t Tilt Maximum     = %6.1f\n", tmin, tmax);
-		fprintf(fp, "Tilt Mean        = %6.2f \t Tilt Stdev       = %6.2f\n", tmean, trms);
-		fprintf(fp, "****************************** Statistical results ******************************\n");
-	}
+	return 0;
 }
-//////////////////////////////////////////////////////////////////////////////
 
 int main(int argc, char** argv) {
+	MountTopology topo;
+	vector<string> streams;	// 流式输入
+	double nsigma(0.0);		// sigma裁剪阈值
+	MatchPolicy policy(MATCH_NEAREST);	// 匹配策略
+	int window(STREAM_WINDOW);	// 流式历史窗口, 量纲: 0.01秒
+	int nshift;				// 选项占用的参数数量
+	while (argc >= 2) {
+		nshift = 2;
+		if (!strcmp(argv[1], "-i")) {
+			policy = MATCH_INTERP;
+			nshift = 1;
+		}
+		else if (argc < 3 || !(!strcmp(argv[1], "-t") || !strcmp(argv[1], "-s") || !strcmp(argv[1], "-c")
+				|| !strcmp(argv[1], "-m") || !strcmp(argv[1], "-w"))) break;
+		else if (argv[1][1] == 's') streams.push_back(argv[2]);
+		else if (argv[1][1] == 'w') window = (int) (atof(argv[2]) * 100.0 + 0.5);
+		else if (argv[1][1] == 'c') nsigma = atof(argv[2]);
+		else if (argv[1][1] == 'm') {
+			if (!MatchPolicyByName(argv[2], policy)) {
+				printf("\nunknown match policy<%s>\n", argv[2]);
+				return -1;
+			}
+		}
+		else if (!topo.Load(argv[2])) {
+			if (topo.Errors().empty()) printf("\nfail to open topology file<%s>\n", argv[2]);
+			else printf("\ninvalid line %d in topology file<%s>\n", topo.Errors()[0], argv[2]);
+			return -1;
+		}
+		argv[nshift] = argv[0];
+		argc -= nshift;
+		argv += nshift;
+	}
+	if (!streams.empty()) return RunStream(argc, argv, topo, streams, window);
 	if (argc < 3) {
-		printf("\nUsage:\n\trelpos <path 1> <path 2> <rotation base> <inclination base>\n");
+		printf("\nUsage:\n\trelpos [-m policy] [-t topology] [-c nsigma] <path 1> <path 2> <rotation base> <inclination base>\n");
+		printf("\trelpos [-m policy] [-t topology] [-c nsigma] -b <directory or manifest> <rotation base> <inclination base>\n");
+		printf("\trelpos [-t topology] [-w window] -s <input 1> [-s <input 2>] <rotation base> <inclination base>\n");
+		printf("\trelpos [-t topology] [-w window] -f <path 1> <path 2> <rotation base> <inclination base>\n");
+		printf("\trelpos [-t topology] [-w window] -d <socket path> <rotation base> <inclination base>\n");
 		return -1;
 	}
-	pathSrc1 = argv[1];
-	pathSrc2 = argv[2];
-	rot0  = argc >= 4 ? atof(argv[3]) : 0.0;
-	tilt0 = argc >= 5 ? atof(argv[4]) : 0.0;
-	bjfov = bffov = false;
-
-	if (!ResolveFile(pathSrc1)) {
+	if (!strcmp(argv[1], "-d")) return RunDaemon(argc, argv, topo, window);
+	if (!strcmp(argv[1], "-b")) return RunBatch(argc, argv, topo, nsigma, policy);
+	if (!strcmp(argv[1], "-f")) {
+		if (argc < 4) {
+			printf("\nUsage:\n\trelpos [-t topology] [-w window] -f <path 1> <path 2> <rotation base> <inclination base>\n");
+			return -1;
+		}
+		return RunFollow(argc, argv, topo, window);
+	}
+	string pathSrc1 = argv[1];	// 输入文件路径名
+	string pathSrc2 = argv[2];
+	RelPosSession session;
+	session.SetTopology(topo);
+	session.SetClip(nsigma);
+	session.SetPolicy(policy);
+	session.SetBase(argc >= 4 ? atof(argv[3]) : 0.0, argc >= 5 ? atof(argv[4]) : 0.0);
+
+	if (!session.ResolveFile(pathSrc1)) {
 		printf("\nfail to resolve file<%s>\n", pathSrc1.c_str());
 		return -2;
 	}
-	if (!ResolveFile(pathSrc2)) {
+	if (!session.ResolveFile(pathSrc2)) {
 		printf("\nfail to resolve file<%s>\n", pathSrc2.c_str());
 		return -2;
 	}
-	if (!bjfov) {
+	if (!session.HasJFoV()) {
 		printf("\nJFoV data is unavailable\n");
 		return -3;
 	}
-	if (!bffov) {
+	if (!session.HasFFoV()) {
 		printf("\nFFoV data is unavailable\n");
 		return -3;
 	}
-	if (!(TimeCheck(&pt_jfov) && TimeCheck(&pt_ffov) && TimeCrossCheck())) {
+	if (!session.TimeCrossCheck()) {
 		printf("\ntime range do not match\n");
 		return -4;
 	}
 
-	ScanData();
-
-	if (!pt_cross.size()) {
+	if (!session.ScanData()) {
 		printf("\nno any data matches condition\n");
 	}
 	else {
-		OutputResult(stdout); // 输出到控制台
+		const string& pathDst = session.OutputPath();
+		session.OutputResult(stdout); // 输出到控制台
 		// 输出到文件
 		FILE* fp = fopen(pathDst.c_str(), "w");
 		if (fp) {
 			printf("---------- results are saved as file<%s> ----------\n", pathDst.c_str());
-			OutputResult(fp);
+			session.OutputResult(fp);
 			fclose(fp);
 		}
 		else {
 			printf("\nfailed to create result file<%s>\n", pathDst.c_str());
 		}
-
-		pt_cross.clear();
 	}
 
 	printf("\n");
@@ -0,0 +1,97 @@
+/*
+ Name        : relpos_arena.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 顺序分配的内存区
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+#include "relpos_arena.h"
+
+Arena::Arena(size_t block, bool huge) {
+	ptr_   = NULL;
+	end_   = NULL;
+	used_  = 0;
+	huge_  = huge;
+	block_ = huge ? (block + ARENA_HUGE - 1) / ARENA_HUGE * ARENA_HUGE : block;
+}
+
+Arena::~Arena() {
+	for (size_t i = 0; i < blocks_.size(); ++i) Unmap(blocks_[i]);
+}
+
+void Arena::Unmap(const Block& block) {
+	munmap(block.base, block.size);
+}
+
+/*
+ * 大页优先使用预留的大页(MAP_HUGETLB), 无预留时退回普通映射并建议透明大页
+ */
+bool Arena::Grow(size_t need) {
+	size_t unit = huge_ ? ARENA_HUGE : 4096;
+	Block block;
+	void* addr = MAP_FAILED;
+
+	block.size = need <= block_ ? block_ : (need + unit - 1) / unit * unit;
+#ifdef MAP_HUGETLB
+	if (huge_) addr = mmap(NULL, block.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	if (addr == MAP_FAILED) {
+		addr = mmap(NULL, block.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (addr == MAP_FAILED) return false;
+#ifdef MADV_HUGEPAGE
+		if (huge_) madvise(addr, block.size, MADV_HUGEPAGE);
+#endif
+	}
+
+	block.base = (char*) addr;
+	blocks_.push_back(block);
+	ptr_ = block.base;
+	end_ = block.base + block.size;
+	return true;
+}
+
+void* Arena::Alloc(size_t size, size_t align) {
+	size_t pad = (align - (size_t) ptr_ % align) % align;
+	if (!ptr_ || pad + size > (size_t) (end_ - ptr_)) {
+		if (!Grow(size)) return NULL;
+		pad = 0;
+	}
+
+	void* addr = ptr_ + pad;
+	ptr_  += pad + size;
+	used_ += pad + size;
+	return addr;
+}
+
+TextSpan Arena::Copy(const char* ptr, int len) {
+	char* dst;
+	if (len <= 0 || !(dst = (char*) Alloc(len, 1))) return TextSpan();
+	memcpy(dst, ptr, len);
+	return TextSpan(dst, len);
+}
+
+bool Arena::Reserve(size_t size) {
+	return (ptr_ && size <= (size_t) (end_ - ptr_)) || Grow(size);
+}
+
+/*
+ * 保留最大的块, 使重复的同规模使用不再映射内存
+ */
+void Arena::Reset() {
+	int n = blocks_.size(), i, keep(0);
+	for (i = 1; i < n; ++i) {
+		if (blocks_[i].size > blocks_[keep].size) keep = i;
+	}
+	for (i = 0; i < n; ++i) {
+		if (i != keep) Unmap(blocks_[i]);
+	}
+	if (n) {
+		blocks_[0] = blocks_[keep];
+		blocks_.resize(1);
+	}
+	ptr_  = n ? blocks_[0].base : NULL;
+	end_  = n ? blocks_[0].base + blocks_[0].size : NULL;
+	used_ = 0;
+}
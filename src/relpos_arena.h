@@ -0,0 +1,154 @@
+/*
+ Name        : relpos_arena.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 顺序分配的内存区
+ 内存区由若干匿名映射块组成, 分配只移动块内指针, 不单独释放. 清空时保留最大
+ 的块复用, 析构时一次解除全部映射. 可选以大页为后备, 减少TLB缺失
+ */
+
+#ifndef RELPOS_ARENA_H_
+#define RELPOS_ARENA_H_
+
+#include <vector>
+#include <stddef.h>
+#include "relpos_point.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/// 宏定义
+#define ARENA_BLOCK	65536		// 内存块的缺省长度, 量纲: 字节
+#define ARENA_HUGE	(2 << 20)	// 大页长度, 量纲: 字节
+
+class Arena {// 顺序分配的内存区
+public:
+	/*!
+	 * @brief 构造函数
+	 * @param block 内存块长度, 量纲: 字节
+	 * @param huge  是否以大页为后备. 为true时块长度取大页长度的整数倍
+	 * @note
+	 * 首次分配时才映射内存块
+	 */
+	explicit Arena(size_t block = ARENA_BLOCK, bool huge = false);
+	virtual ~Arena();
+
+public:
+	/*!
+	 * @brief 分配内存
+	 * @param size  长度, 量纲: 字节
+	 * @param align 对齐字节数, 2的幂
+	 * @return
+	 * 内存地址. 无法映射新内存块时返回NULL
+	 * @note
+	 * 当前块剩余空间不足时映射新块, 超过块长度的请求独占一块
+	 */
+	void* Alloc(size_t size, size_t align = sizeof(double));
+	/*!
+	 * @brief 分配对象数组, 不调用构造函数
+	 * @param n 对象数量
+	 */
+	template <class T>
+	T* New(size_t n) {
+		return (T*) Alloc(n * sizeof(T), alignof(T));
+	}
+	/*!
+	 * @brief 复制文本到内存区
+	 * @param ptr 文本起始地址
+	 * @param len 文本长度
+	 * @return
+	 * 指向复制内容的文本片段. 长度为0或分配失败时为空片段
+	 */
+	TextSpan Copy(const char* ptr, int len);
+	/*!
+	 * @brief 确保当前块的剩余空间
+	 * @param size 长度, 量纲: 字节
+	 * @return
+	 * 剩余空间足够或映射新块成功时返回true
+	 * @note
+	 * 预先给出一组分配的总长度(含对齐填充), 使其全部位于同一块中
+	 */
+	bool Reserve(size_t size);
+	/*!
+	 * @brief 清空内存区
+	 * @note
+	 * 此前分配的地址全部失效. 最大的块保留复用, 其它块解除映射
+	 */
+	void Reset();
+	/*!
+	 * @brief 已分配的字节数, 含对齐填充
+	 */
+	size_t Used() const {
+		return used_;
+	}
+
+protected:
+	struct Block {// 内存块
+		char* base;		//< 起始地址
+		size_t size;	//< 长度
+	};
+
+	/*!
+	 * @brief 映射新内存块并设为当前块
+	 * @param need 最小长度
+	 */
+	bool Grow(size_t need);
+	/*!
+	 * @brief 解除内存块映射
+	 */
+	static void Unmap(const Block& block);
+
+protected:
+	std::vector<Block> blocks_;	//< 已映射的内存块, 最后一块为当前块
+	char* ptr_;			//< 当前块的空闲起始地址
+	char* end_;			//< 当前块的结束地址
+	size_t block_;		//< 内存块长度
+	size_t used_;		//< 已分配的字节数
+	bool huge_;			//< 是否以大页为后备
+
+private:
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+};
+
+template <class T>
+class ArenaArray {// 在内存区中分配的定长数组, 不拥有内容. 接口与vector的对应部分一致
+public:
+	ArenaArray() : ptr_(NULL), size_(0) {}
+
+	/*!
+	 * @brief 在内存区中分配数组
+	 * @param arena 内存区
+	 * @param n     元素数量
+	 * @return
+	 * 分配成功时返回true
+	 * @note
+	 * 元素不初始化. 内存区清空后数组失效, 须先clear()
+	 */
+	bool Assign(Arena& arena, int n) {
+		ptr_  = n > 0 ? arena.New<T>(n) : NULL;
+		size_ = ptr_ ? n : 0;
+		return ptr_ || n <= 0;
+	}
+
+	void clear() {
+		ptr_  = NULL;
+		size_ = 0;
+	}
+
+	int size() const {
+		return size_;
+	}
+
+	bool empty() const {
+		return !size_;
+	}
+
+	T& operator[](int i) const {
+		return ptr_[i];
+	}
+
+protected:
+	T* ptr_;	//< 首元素地址
+	int size_;	//< 元素数量
+};
+
+#endif /* RELPOS_ARENA_H_ */
@@ -0,0 +1,272 @@
+/*
+ Name        : relpos_batch.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 整夜指向文件批处理
+ */
+
+#include <algorithm>
+#include <map>
+#include <stdlib.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "relpos_batch.h"
+#include "relpos_pool.h"
+
+/*
+ * 结果文件名: G<cam_id>_<hhmm>-<hhmm>.txt
+ */
+static bool IsResultName(const char* name) {
+	const char* tail = "_dddd-dddd.txt";
+	int n = strlen(name), m = strlen(tail), i;
+	if (n <= m + 1 || name[0] != 'G') return false;
+	for (i = 0, name += n - m; i < m; ++i) {
+		if (tail[i] == 'd' ? !isdigit(name[i]) : name[i] != tail[i]) return false;
+	}
+	return true;
+}
+
+RelPosBatch::RelPosBatch() {
+	log_    = stdout;
+	rot0_   = 0.0;
+	tilt0_  = 0.0;
+	nthread_= 0;
+	nsigma_ = 0.0;
+	policy_ = MATCH_NEAREST;
+}
+
+RelPosBatch::~RelPosBatch() {
+	jobs_.clear();
+	files_.clear();
+}
+
+void RelPosBatch::SetLog(FILE* fp) {
+	log_ = fp;
+}
+
+void RelPosBatch::SetBase(double rot, double tilt) {
+	rot0_  = rot;
+	tilt0_ = tilt;
+}
+
+void RelPosBatch::SetTopology(const MountTopology& topo) {
+	topo_ = topo;
+}
+
+void RelPosBatch::SetThreads(int n) {
+	nthread_ = n;
+}
+
+void RelPosBatch::SetClip(double nsigma) {
+	nsigma_ = nsigma;
+}
+
+void RelPosBatch::SetPolicy(MatchPolicy policy) {
+	policy_ = policy;
+}
+
+/*
+ * 目录内文件按名称排序, 使任务顺序与readdir顺序无关
+ */
+int RelPosBatch::AddPath(const string& path) {
+	struct stat st;
+	vector<string> paths;
+	if (stat(path.c_str(), &st)) return -1;
+
+	if (S_ISDIR(st.st_mode)) {
+		DIR* dir = opendir(path.c_str());
+		struct dirent* ent;
+		if (!dir) return -1;
+		while ((ent = readdir(dir)) != NULL) {
+			string filepath = path + "/" + ent->d_name;
+			if (ent->d_name[0] == '.' || IsResultName(ent->d_name)) continue;
+			if (stat(filepath.c_str(), &st) || !S_ISREG(st.st_mode)) continue;
+			paths.push_back(filepath);
+		}
+		closedir(dir);
+		std::sort(paths.begin(), paths.end());
+	}
+	else {
+		FILE* fp = fopen(path.c_str(), "r");
+		size_t pos = path.rfind('/');
+		string prefix = pos == string::npos ? "" : path.substr(0, pos + 1);
+		char line[1024];
+		char *first, *last;
+		if (!fp) return -1;
+		while (fgets(line, sizeof(line), fp)) {
+			for (first = line; isspace(*first); ++first);
+			for (last = first + strlen(first); last > first && isspace(last[-1]); --last);
+			*last = 0;
+			if (!*first || *first == '#') continue;
+			paths.push_back(*first == '/' ? string(first) : prefix + first);
+		}
+		fclose(fp);
+	}
+
+	for (size_t i = 0; i < paths.size(); ++i) {
+		SourceFile src;
+		src.path  = paths[i];
+		src.known = false;
+		files_.push_back(src);
+	}
+	return paths.size();
+}
+
+/*
+ * 每个任务使用独立的相机标志驻留表, 任务间不共享可变状态
+ */
+void RelPosBatch::LoadSource(SourceFile* src) {
+	std::shared_ptr<PointFile> ptf(new PointFile);
+	CameraTable cameras;
+
+	if (!LoadPointFile(src->path, *ptf, cameras) || !ptf->Size()) return;
+	src->known = topo_.Classify(ptf->cid, src->role);
+	src->data = ptf;
+}
+
+/*
+ * 时间重叠量按匹配容差扩展, 与RelPosSession::TimeCrossCheck()判据一致.
+ * 输出文件名相同的JFoV文件只处理第一个, 避免多个任务写入同一文件
+ */
+void RelPosBatch::PlanJobs() {
+	typedef std::multimap<string, int> MountMap;
+	MountMap ffovs;	// 转台名称 -> FFoV文件
+	std::map<string, int> outputs;	// 输出文件名 -> JFoV文件
+	int n = files_.size(), i;
+
+	jobs_.clear();
+	for (i = 0; i < n; ++i) {
+		const SourceFile& src = files_[i];
+		if (src.known && src.role.ffov) ffovs.insert(std::make_pair(src.role.mount, i));
+	}
+
+	for (i = 0; i < n; ++i) {
+		const SourceFile& src = files_[i];
+		if (!src.known || src.role.ffov) continue;
+
+		const vector<TimeStamp>& t1 = src.data->index.keys;
+		std::pair<MountMap::iterator, MountMap::iterator> range = ffovs.equal_range(src.role.mount);
+		TimeStamp best = -1, overlap;
+		int k = -1;
+		for (MountMap::iterator it = range.first; it != range.second; ++it) {
+			const vector<TimeStamp>& t2 = files_[it->second].data->index.keys;
+			overlap = std::min(t1.back(), t2.back() + MATCH_TOL) - std::max(t1.front(), t2.front() - MATCH_TOL);
+			if (overlap > best) {
+				best = overlap;
+				k = it->second;
+			}
+		}
+
+		if (k < 0) {
+			LogPrint(log_, "no FFoV data matches file<%s> in time\n", src.path.c_str());
+			continue;
+		}
+
+		PairJob job;
+		job.jfov    = i;
+		job.ffov    = k;
+		job.matched = 0;
+		job.pathDst = ResultPath(*src.data);
+		job.saved   = false;
+		if (!outputs.insert(std::make_pair(job.pathDst, i)).second) {
+			LogPrint(log_, "file<%s> is skipped: result file<%s> belongs to file<%s>\n", src.path.c_str(),
+					job.pathDst.c_str(), files_[outputs[job.pathDst]].path.c_str());
+		}
+		else jobs_.push_back(job);
+	}
+}
+
+/*
+ * 任务已并行执行, 会话内部不再分段并行
+ */
+void RelPosBatch::RunJob(PairJob* job) {
+	const CameraRole& role = files_[job->jfov].role;
+	RelPosSession session;
+	session.SetLog(NULL);
+	session.SetThreads(1);
+	session.SetClip(nsigma_);
+	session.SetPolicy(policy_);
+	if (role.based) session.SetBase(role.rot0, role.tilt0);
+	else session.SetBase(rot0_, tilt0_);
+	session.Attach(files_[job->ffov].data, true);
+	session.Attach(files_[job->jfov].data, false);
+
+	if (!(job->matched = session.ScanData())) return;
+	job->stat = session.Stat();
+
+	FILE* fp = fopen(job->pathDst.c_str(), "w");
+	if (fp) {
+		session.OutputResult(fp);
+		fclose(fp);
+		job->saved = true;
+	}
+}
+
+int RelPosBatch::Run() {
+	WorkPool pool(nthread_);
+	int n = files_.size(), saved(0), i;
+
+	LogPrint(log_, "\n---------- Resolving %d files with %d threads ----------\n", n, pool.Size());
+	for (i = 0; i < n; ++i) pool.Submit(std::bind(&RelPosBatch::LoadSource, this, &files_[i]));
+	pool.Wait();
+	for (i = 0; i < n; ++i) {
+		const SourceFile& src = files_[i];
+		if (!src.data) LogPrint(log_, "fail to resolve file<%s>\n", src.path.c_str());
+		else if (!src.known) {
+			LogPrint(log_, "camera<%s> of file<%s> is not found in topology\n",
+					src.data->cid.c_str(), src.path.c_str());
+		}
+		else {
+			LogPrint(log_, "file<%s>: %d points from %s on mount %s\n", src.path.c_str(),
+					src.data->Size(), src.role.ffov ? "FFoV" : "JFoV", src.role.mount.c_str());
+		}
+	}
+
+	PlanJobs();
+	n = jobs_.size();
+	LogPrint(log_, "\n---------- Scanning %d pairs of files ----------\n", n);
+	for (i = 0; i < n; ++i) pool.Submit(std::bind(&RelPosBatch::RunJob, this, &jobs_[i]));
+	pool.Wait();
+	for (i = 0; i < n; ++i) {
+		const PairJob& job = jobs_[i];
+		const char* name = files_[job.jfov].path.c_str();
+		if (!job.matched) LogPrint(log_, "no any data matches condition for file<%s>\n", name);
+		else if (!job.saved) LogPrint(log_, "failed to create result file<%s>\n", job.pathDst.c_str());
+		else {
+			LogPrint(log_, "%d matched points of file<%s> are saved as file<%s>\n",
+					job.matched, name, job.pathDst.c_str());
+			++saved;
+		}
+	}
+	OutputCombined();
+
+	return saved;
+}
+
+/*
+ * 各文件统计量按JFoV起始时间顺序合并
+ */
+void RelPosBatch::OutputCombined() {
+	typedef std::map<string, vector<int> > CameraJobs;
+	CameraJobs cams;
+	int n = jobs_.size(), i;
+
+	if (!log_) return;
+	for (i = 0; i < n; ++i) {
+		if (jobs_[i].matched) cams[files_[jobs_[i].jfov].data->cid].push_back(i);
+	}
+	for (CameraJobs::iterator it = cams.begin(); it != cams.end(); ++it) {
+		vector<int>& order = it->second;
+		if (order.size() < 2) continue;
+
+		std::sort(order.begin(), order.end(), [this](int a, int b) {
+			return files_[jobs_[a].jfov].data->index.keys[0] < files_[jobs_[b].jfov].data->index.keys[0];
+		});
+		CrossStat stat;
+		for (i = 0; i < (int) order.size(); ++i) stat.Merge(jobs_[order[i]].stat);
+		LogPrint(log_, "\n---------- combined statistics of %lu files from camera<%s> ----------\n",
+				order.size(), it->first.c_str());
+		stat.Output(log_);
+	}
+}
@@ -0,0 +1,128 @@
+/*
+ Name        : relpos_batch.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 整夜指向文件批处理
+ 输入为目录或清单文件. 全部文件解析一次后按转台分组, 每个JFoV文件与同一转台
+ 时间重叠最多的FFoV文件组成一个计算任务. FFoV数据由同组任务共享.
+ 解析与计算任务都在工作窃取线程池中执行
+ */
+
+#ifndef RELPOS_BATCH_H_
+#define RELPOS_BATCH_H_
+
+#include <stdio.h>
+#include "relpos_point.h"
+#include "relpos_topology.h"
+#include "relpos_session.h"
+
+class RelPosBatch {// 整夜指向文件批处理
+public:
+	RelPosBatch();
+	virtual ~RelPosBatch();
+
+public:
+	/*!
+	 * @brief 设置过程信息的输出位置
+	 * @param fp 文件描述符. NULL时不输出过程信息
+	 */
+	void SetLog(FILE* fp);
+	/*!
+	 * @brief 设置旋转与倾斜基准
+	 * @param rot  旋转基准, 量纲: 角度
+	 * @param tilt 倾斜基准, 量纲: 角度
+	 */
+	void SetBase(double rot, double tilt);
+	/*!
+	 * @brief 设置转台拓扑
+	 * @param topo 转台拓扑
+	 * @note
+	 * 拓扑给定名义基准的JFoV使用其名义基准, 其它JFoV使用SetBase()设置的基准
+	 */
+	void SetTopology(const MountTopology& topo);
+	/*!
+	 * @brief 设置工作线程数量
+	 * @param n 线程数量. <=0时取处理器数量
+	 */
+	void SetThreads(int n);
+	/*!
+	 * @brief 设置sigma裁剪
+	 * @param nsigma 裁剪阈值, 标准差的倍数. <=0时不裁剪
+	 */
+	void SetClip(double nsigma);
+	/*!
+	 * @brief 设置匹配策略
+	 * @param policy 匹配策略
+	 */
+	void SetPolicy(MatchPolicy policy);
+	/*!
+	 * @brief 添加输入文件
+	 * @param path 目录或清单文件路径
+	 * @return
+	 * 添加的文件数量. 路径无法访问时返回-1
+	 * @note
+	 * 目录: 添加其中的全部常规文件, 忽略隐藏文件和结果文件
+	 * @note
+	 * 清单: 每行一个文件路径, 忽略空行和以#开始的行. 相对路径相对于清单所在目录
+	 */
+	int AddPath(const string& path);
+	/*!
+	 * @brief 解析全部文件, 计算相对位置并输出结果文件
+	 * @return
+	 * 输出的结果文件数量
+	 * @note
+	 * 结果文件写入当前目录, 文件名格式与单对文件处理相同
+	 * @note
+	 * 同一JFoV相机有多个结果文件(如多夜数据)时, 合并各文件统计量输出总体统计
+	 */
+	int Run();
+
+protected:
+	struct SourceFile {// 输入文件
+		string path;		//< 文件路径
+		PointFilePtr data;	//< 文件数据. 无法解析时为空
+		CameraRole role;	//< 相机角色
+		bool known;			//< 相机是否在转台拓扑中
+	};
+
+	struct PairJob {// JFoV/FFoV计算任务
+		int jfov, ffov;	//< JFoV和FFoV文件在files_中的位置
+		int matched;	//< 匹配数据点数量
+		string pathDst;	//< 输出文件名
+		bool saved;		//< 结果文件是否写入成功
+		CrossStat stat;	//< 结果统计量
+	};
+
+	/*!
+	 * @brief 解析输入文件
+	 */
+	void LoadSource(SourceFile* src);
+	/*!
+	 * @brief 为各JFoV文件选择FFoV文件, 生成计算任务
+	 */
+	void PlanJobs();
+	/*!
+	 * @brief 执行计算任务
+	 */
+	void RunJob(PairJob* job);
+	/*!
+	 * @brief 合并同一JFoV相机的结果统计量并输出
+	 */
+	void OutputCombined();
+
+protected:
+	FILE* log_;			//< 过程信息输出位置
+	double rot0_, tilt0_;	//< 旋转与倾斜基准, 量纲: 角度
+	int nthread_;		//< 工作线程数量
+	double nsigma_;		//< sigma裁剪阈值
+	MatchPolicy policy_;	//< 匹配策略
+	MountTopology topo_;	//< 转台拓扑
+	vector<SourceFile> files_;	//< 输入文件
+	vector<PairJob> jobs_;		//< 计算任务
+
+private:
+	RelPosBatch(const RelPosBatch&);
+	RelPosBatch& operator=(const RelPosBatch&);
+};
+
+#endif /* RELPOS_BATCH_H_ */
@@ -0,0 +1,110 @@
+/*
+ Name        : relpos_clip.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 旋转角与倾斜角的迭代sigma裁剪
+ */
+
+#include <algorithm>
+#include "relpos_clip.h"
+
+SigmaClip::SigmaClip() {
+	nkept_   = 0;
+	changed_ = 0;
+	niter_   = 0;
+}
+
+int SigmaClip::Count() const {
+	return count_.size() - nkept_;
+}
+
+int SigmaClip::Iterations() const {
+	return niter_;
+}
+
+void SigmaClip::Reject(int i) {
+	if (count_[i]++) return;
+	for (int k = 0; k < 2; ++k) {
+		double x = axes_[k].value[i];
+		axes_[k].sum -= x;
+		axes_[k].sq  -= x * x;
+	}
+	--nkept_;
+	++changed_;
+}
+
+void SigmaClip::Restore(int i) {
+	if (--count_[i]) return;
+	for (int k = 0; k < 2; ++k) {
+		double x = axes_[k].value[i];
+		axes_[k].sum += x;
+		axes_[k].sq  += x * x;
+	}
+	++nkept_;
+	++changed_;
+}
+
+/*
+ * 裁剪界收缩时端点向内移动并剔除越界数据点, 扩张时向外移动并恢复
+ */
+void SigmaClip::Bound(ClipAxis& axis, double lower, double upper) {
+	const vector<double>& v = axis.value;
+	const vector<int>& order = axis.order;
+	int n = order.size();
+
+	while (axis.lo > 0 && v[order[axis.lo - 1]] >= lower) Restore(order[--axis.lo]);
+	while (axis.lo < axis.hi && v[order[axis.lo]] < lower) Reject(order[axis.lo++]);
+	while (axis.hi < n && v[order[axis.hi]] <= upper) Restore(order[axis.hi++]);
+	while (axis.hi > axis.lo && v[order[axis.hi - 1]] > upper) Reject(order[--axis.hi]);
+}
+
+/*
+ * 旋转角相对全体圆周均值展开, 倾斜角减去全体均值, 使和与平方和的量级接近0
+ */
+int SigmaClip::Run(const PtCrossV& pts, double nsigma, int niter) {
+	int n = pts.size(), i, k;
+	CrossStat stat;
+	double rmean, rrms, tmean, trms;
+	double center[2], half[2];
+
+	count_.assign(n, 0);
+	nkept_ = n;
+	niter_ = 0;
+	if (!n) return 0;
+
+	for (i = 0; i < n; ++i) stat.Add(pts[i].rot, pts[i].tilt);
+	stat.Summary(rmean, rrms, tmean, trms);
+	for (k = 0; k < 2; ++k) {
+		ClipAxis& axis = axes_[k];
+		axis.value.resize(n);
+		axis.order.resize(n);
+		axis.sum = axis.sq = 0.0;
+		for (i = 0; i < n; ++i) {
+			double x = k ? pts[i].tilt - tmean : CrossStat::Deviate(pts[i].rot, rmean);
+			axis.value[i] = x;
+			axis.order[i] = i;
+			axis.sum += x;
+			axis.sq  += x * x;
+		}
+		const vector<double>& v = axis.value;
+		std::sort(axis.order.begin(), axis.order.end(), [&v](int a, int b) { return v[a] < v[b]; });
+		axis.lo = 0;
+		axis.hi = n;
+	}
+
+	do {
+		changed_ = 0;
+		if (nkept_ < 3) break;
+		++niter_;
+		for (k = 0; k < 2; ++k) {// 两个角度的裁剪界都由本次迭代前的保留数据点确定
+			const ClipAxis& axis = axes_[k];
+			double mean = axis.sum / nkept_;
+			double var  = axis.sq / nkept_ - mean * mean;
+			half[k]   = nsigma * sqrt(var > 0.0 ? var : 0.0);
+			center[k] = mean;
+		}
+		for (k = 0; k < 2; ++k) Bound(axes_[k], center[k] - half[k], center[k] + half[k]);
+	} while (changed_ && niter_ < niter);
+
+	return n - nkept_;
+}
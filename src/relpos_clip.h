@@ -0,0 +1,81 @@
+/*
+ Name        : relpos_clip.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 旋转角与倾斜角的迭代sigma裁剪
+ 旋转角取相对全体圆周均值的偏差, 与倾斜角分别排序一次. 保留的数据点在各自
+ 排序中为连续区间[lo, hi), 每次迭代按新的裁剪界移动区间端点, 只检查界附近
+ 状态改变的数据点并增量更新和与平方和. 任一角度超出裁剪界的数据点被剔除
+ */
+
+#ifndef RELPOS_CLIP_H_
+#define RELPOS_CLIP_H_
+
+#include "relpos_session.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/// 宏定义
+#define CLIP_ITER	10		// 最多迭代次数
+
+class SigmaClip {// 迭代sigma裁剪
+public:
+	SigmaClip();
+
+public:
+	/*!
+	 * @brief 执行裁剪
+	 * @param pts    交叉数据点
+	 * @param nsigma 裁剪阈值, 标准差的倍数
+	 * @param niter  最多迭代次数
+	 * @return
+	 * 被剔除的数据点数量
+	 * @note
+	 * 无数据点被剔除或恢复时提前结束
+	 */
+	int Run(const PtCrossV& pts, double nsigma, int niter = CLIP_ITER);
+	/*!
+	 * @brief 数据点是否被剔除
+	 * @param i 数据点位置
+	 */
+	bool Rejected(int i) const {
+		return count_[i] > 0;
+	}
+	/*!
+	 * @brief 被剔除的数据点数量
+	 */
+	int Count() const;
+	/*!
+	 * @brief 实际迭代次数
+	 */
+	int Iterations() const;
+
+protected:
+	struct ClipAxis {// 一个角度的排序与保留区间
+		vector<double> value;	//< 各数据点的值
+		vector<int> order;		//< 按值排序的数据点位置
+		int lo, hi;				//< 保留区间在order中的范围[lo, hi)
+		double sum, sq;			//< 保留数据点的和与平方和
+	};
+
+	/*!
+	 * @brief 数据点被一个角度剔除
+	 */
+	void Reject(int i);
+	/*!
+	 * @brief 数据点被一个角度恢复
+	 */
+	void Restore(int i);
+	/*!
+	 * @brief 按裁剪界[lower, upper]移动保留区间端点
+	 */
+	void Bound(ClipAxis& axis, double lower, double upper);
+
+protected:
+	ClipAxis axes_[2];		//< 旋转角与倾斜角
+	vector<char> count_;	//< 各数据点被剔除的角度数量
+	int nkept_;				//< 保留的数据点数量
+	int changed_;			//< 本次迭代状态改变的数据点数量
+	int niter_;				//< 实际迭代次数
+};
+
+#endif /* RELPOS_CLIP_H_ */
@@ -0,0 +1,197 @@
+/*
+ Name        : relpos_daemon.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 常驻进程, 经Unix域套接字接收指向记录并应答查询
+ */
+
+#include <algorithm>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "relpos_daemon.h"
+
+RelPosDaemon::RelPosDaemon() : stop_(false) {
+	log_    = stdout;
+	latest_ = -1;
+}
+
+RelPosDaemon::~RelPosDaemon() {
+	states_.clear();
+}
+
+void RelPosDaemon::Stop() {
+	stop_ = true;
+}
+
+void RelPosDaemon::Emit(const StreamPoint& jp, const CrossRecord& ptc, double rot0, double tilt0) {
+	CameraState& state = states_[jp.cam];
+	if (state.cid.empty()) state.cid = cameras_.Name(jp.cam);
+	state.t    = jp.t;
+	state.rot  = ptc.rot;
+	state.tilt = ptc.tilt;
+	RelativeBase(ptc, rot0, tilt0, state.rrot, state.rtilt);
+	state.stat.Add(ptc.rot, ptc.tilt);
+	latest_ = jp.cam;
+}
+
+void RelPosDaemon::Query(const char* cid, int len, DaemonResult* rslt) const {
+	CameraStateMap::const_iterator it = states_.end();
+	if (!len) it = states_.find(latest_);
+	else {
+		for (it = states_.begin(); it != states_.end()
+				&& !((int) it->second.cid.size() == len && !memcmp(it->second.cid.data(), cid, len)); ++it);
+	}
+	if (it == states_.end()) {
+		rslt->status = DST_NODATA;
+		return;
+	}
+
+	const CameraState& state = it->second;
+	rslt->status = DST_OK;
+	memcpy(rslt->cid, state.cid.data(), std::min(state.cid.size(), sizeof(rslt->cid)));	// 不足8字节时以0填充
+	rslt->t     = state.t;
+	rslt->rot   = state.rot;
+	rslt->tilt  = state.tilt;
+	rslt->rrot  = state.rrot;
+	rslt->rtilt = state.rtilt;
+	rslt->n     = state.stat.n;
+	state.stat.Summary(rslt->rmean, rslt->rrms, rslt->tmean, rslt->trms);
+	state.stat.Range(rslt->rmin, rslt->rmax);
+	rslt->tmin  = state.stat.tmin;
+	rslt->tmax  = state.stat.tmax;
+	rslt->rlen  = state.stat.Resultant();
+	state.stat.Quantile(0.50, rslt->rmed, rslt->tmed);
+	state.stat.Quantile(0.01, rslt->r01, rslt->t01);
+	state.stat.Quantile(0.99, rslt->r99, rslt->t99);
+}
+
+/*
+ * 格式错误的请求以DST_BADREQ应答, 不断开连接
+ */
+int RelPosDaemon::Handle(const char* req, int len, char* reply) {
+	const DaemonHeader* hdr = (const DaemonHeader*) req;
+	const char* payload = req + sizeof(DaemonHeader);
+	bool valid = len >= (int) sizeof(DaemonHeader) && hdr->magic == DAEMON_MAGIC
+			&& hdr->len == len - sizeof(DaemonHeader);
+	int op = len >= (int) sizeof(DaemonHeader) ? hdr->op : 0;
+
+	if (valid && op == DOP_QUERY) {
+		DaemonResult* rslt = (DaemonResult*) reply;
+		memset(rslt, 0, sizeof(DaemonResult));
+		rslt->hdr.magic = DAEMON_MAGIC;
+		rslt->hdr.op    = op;
+		rslt->hdr.len   = sizeof(DaemonResult) - sizeof(DaemonHeader);
+		Query(payload, hdr->len, rslt);
+		return sizeof(DaemonResult);
+	}
+
+	DaemonAck* ack = (DaemonAck*) reply;
+	memset(ack, 0, sizeof(DaemonAck));
+	ack->hdr.magic = DAEMON_MAGIC;
+	ack->hdr.op    = op;
+	ack->hdr.len   = sizeof(DaemonAck) - sizeof(DaemonHeader);
+	ack->status    = DST_BADREQ;
+	if (valid && op == DOP_RECORDS && hdr->len % sizeof(DaemonRecord) == 0) {
+		const DaemonRecord* rec = (const DaemonRecord*) payload;
+		int n = hdr->len / sizeof(DaemonRecord), i;
+		for (i = 0; i < n; ++i, ++rec) {
+			if (FeedRecord(rec->cid, strnlen(rec->cid, sizeof(rec->cid)), rec->t, rec->ra, rec->dc))
+				++ack->accepted;
+		}
+		ack->status = DST_OK;
+	}
+	else if (valid && op == DOP_LINES) {
+		string buff;
+		ack->accepted = FeedChunk(buff, payload, hdr->len);
+		if (!buff.empty() && Feed(buff.data(), buff.data() + buff.size())) ++ack->accepted;
+		ack->status = DST_OK;
+	}
+	ack->matched = matched_;
+
+	return sizeof(DaemonAck);
+}
+
+/*
+ * 单线程轮询监听套接字与客户端连接, 请求逐个处理. 周期性超时以检查结束请求.
+ * 只删除路径上已有的套接字(上次运行的残留), 防止误删同名的普通文件. 结束时
+ * 路径仍为本进程建立的套接字(设备号与节点号一致)才删除
+ */
+bool RelPosDaemon::Serve(const string& path) {
+	struct sockaddr_un addr;
+	vector<struct pollfd> fds;
+	vector<char> req(DAEMON_MSG_MAX), reply(DAEMON_MSG_MAX);
+	struct pollfd pfd;
+	struct stat st, own;
+	int sock, i;
+
+	if (path.size() >= sizeof(addr.sun_path)) {
+		LogPrint(log_, "socket path<%s> is too long\n", path.c_str());
+		return false;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+	if (!lstat(path.c_str(), &st)) {
+		if (!S_ISSOCK(st.st_mode)) {
+			LogPrint(log_, "path<%s> exists and is not a socket\n", path.c_str());
+			return false;
+		}
+		unlink(path.c_str());
+	}
+	if ((sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0
+			|| bind(sock, (struct sockaddr*) &addr, sizeof(addr))
+			|| listen(sock, DAEMON_CLIENTS)
+			|| lstat(path.c_str(), &own)) {
+		LogPrint(log_, "fail to listen on socket<%s>\n", path.c_str());
+		if (sock >= 0) close(sock);
+		return false;
+	}
+
+	LogPrint(log_, "listening on socket<%s>\n", path.c_str());
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	fds.push_back(pfd);
+	stop_ = false;
+	while (!stop_) {
+		if (poll(&fds[0], fds.size(), DAEMON_POLL) < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+
+		for (i = fds.size() - 1; i > 0; --i) {
+			if (!fds[i].revents) continue;
+
+			ssize_t len = recv(fds[i].fd, &req[0], req.size(), MSG_TRUNC);
+			if (len <= 0) {// 连接断开
+				close(fds[i].fd);
+				fds.erase(fds.begin() + i);
+				continue;
+			}
+			if (len > (ssize_t) req.size()) len = 0;	// 超长消息按格式错误应答
+			int n = Handle(&req[0], len, &reply[0]);
+			if (send(fds[i].fd, &reply[0], n, MSG_NOSIGNAL) != n) {
+				close(fds[i].fd);
+				fds.erase(fds.begin() + i);
+			}
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int fd = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+			if (fd >= 0 && fds.size() > DAEMON_CLIENTS) close(fd);
+			else if (fd >= 0) {
+				pfd.fd = fd;
+				fds.push_back(pfd);
+			}
+		}
+	}
+
+	for (i = fds.size() - 1; i >= 0; --i) close(fds[i].fd);
+	if (!lstat(path.c_str(), &st) && st.st_dev == own.st_dev && st.st_ino == own.st_ino) unlink(path.c_str());
+	LogPrint(log_, "stop listening on socket<%s>\n", path.c_str());
+
+	return true;
+}
@@ -0,0 +1,131 @@
+/*
+ Name        : relpos_daemon.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 常驻进程, 经Unix域套接字接收指向记录并应答查询
+ 套接字类型为SOCK_SEQPACKET, 每个消息为一个完整请求或应答.
+ 消息由DaemonHeader开始, 其后为载荷. 数值采用本机字节序, 结构按自然对齐
+ 请求:
+   DOP_RECORDS: 载荷为若干DaemonRecord, 应答DaemonAck
+   DOP_LINES  : 载荷为若干文本行, 行格式同指向文件, 应答DaemonAck
+   DOP_QUERY  : 载荷为JFoV相机标志, 为空时查询最近更新的JFoV相机, 应答DaemonResult
+ 请求路径上不做文件读写, 所有状态保存在内存中
+ */
+
+#ifndef RELPOS_DAEMON_H_
+#define RELPOS_DAEMON_H_
+
+#include <atomic>
+#include <map>
+#include <stdint.h>
+#include "relpos_stream.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/// 宏定义
+#define DAEMON_MAGIC	0x5052		// 消息标志
+#define DAEMON_MSG_MAX	65536		// 消息最大长度, 量纲: 字节
+#define DAEMON_CLIENTS	64			// 最多同时连接的客户端数量
+#define DAEMON_POLL		1000		// 检查结束请求的周期, 量纲: 毫秒
+
+//////////////////////////////////////////////////////////////////////////////
+/// 通信协议
+enum {// 操作码
+	DOP_RECORDS = 1,	// 二进制记录
+	DOP_LINES,			// 文本记录
+	DOP_QUERY			// 查询
+};
+
+enum {// 应答状态
+	DST_BADREQ = -1,	// 请求格式错误
+	DST_OK,				// 成功
+	DST_NODATA			// 相机尚无匹配结果
+};
+
+struct DaemonHeader {// 消息头
+	uint16_t magic;		//< 消息标志, DAEMON_MAGIC
+	uint16_t op;		//< 操作码; 应答中与请求相同
+	uint32_t len;		//< 载荷长度, 量纲: 字节
+};
+
+struct DaemonRecord {// 二进制指向记录
+	char cid[8];		//< 相机标志, 不足8字节时以0填充
+	int64_t t;			//< UTC时间戳, 自1970-01-01起的时间, 量纲: 0.01秒
+	double ra, dc;		//< 中心位置, 量纲: 角度
+};
+
+struct DaemonAck {// 记录应答
+	DaemonHeader hdr;	//< 消息头
+	int32_t status;		//< 应答状态
+	int32_t accepted;	//< 本次接受的记录数量
+	int64_t matched;	//< 累计匹配数据点数量
+};
+
+struct DaemonResult {// 查询应答
+	DaemonHeader hdr;	//< 消息头
+	int32_t status;		//< 应答状态
+	char cid[8];		//< JFoV相机标志
+	int64_t t;			//< 最近匹配的JFoV时间
+	double rot, tilt;	//< 最近的旋转角和倾斜角, 量纲: 角度
+	double rrot, rtilt;	//< 最近的相对基准旋转角和倾斜角, 量纲: 角度
+	int64_t n;			//< 统计数据点数量
+	double rmean, rrms, rmin, rmax;	//< 旋转角圆周均值, 圆周标准差, 最小值, 最大值, 量纲: 角度
+	double tmean, trms, tmin, tmax;	//< 倾斜角均值, 标准差, 最小值, 最大值, 量纲: 角度
+	double rlen;		//< 旋转角平均合成矢量长度
+	double rmed, r01, r99;	//< 旋转角中位数, 1%和99%分位数, 量纲: 角度
+	double tmed, t01, t99;	//< 倾斜角中位数, 1%和99%分位数, 量纲: 角度
+};
+
+class RelPosDaemon : public RelPosStream {// 常驻进程
+public:
+	RelPosDaemon();
+	virtual ~RelPosDaemon();
+
+public:
+	/*!
+	 * @brief 在Unix域套接字上服务直至Stop()
+	 * @param path 套接字路径. 已存在的同名套接字被删除
+	 * @return
+	 * 套接字可以建立时返回true. 路径已存在且不是套接字时返回false
+	 * @note
+	 * 结束时只删除本进程建立的套接字
+	 */
+	bool Serve(const string& path);
+	/*!
+	 * @brief 请求结束服务
+	 * @note
+	 * 可在信号处理函数中调用
+	 */
+	void Stop();
+	/*!
+	 * @brief 处理一个请求
+	 * @param req   请求
+	 * @param len   请求长度
+	 * @param reply 应答缓存, 长度不小于DAEMON_MSG_MAX
+	 * @return
+	 * 应答长度
+	 */
+	int Handle(const char* req, int len, char* reply);
+
+protected:
+	struct CameraState {// JFoV相机的最新结果
+		string cid;			//< 相机标志
+		TimeStamp t;		//< 最近匹配的JFoV时间
+		double rot, tilt;	//< 最近的旋转角和倾斜角, 量纲: 角度
+		double rrot, rtilt;	//< 最近的相对基准旋转角和倾斜角, 量纲: 角度
+		CrossStat stat;		//< 统计量
+	};
+	typedef std::map<int, CameraState> CameraStateMap;
+
+	virtual void Emit(const StreamPoint& jp, const CrossRecord& ptc, double rot0, double tilt0);
+	/*!
+	 * @brief 生成查询应答
+	 */
+	void Query(const char* cid, int len, DaemonResult* rslt) const;
+
+protected:
+	std::atomic<bool> stop_;	//< 结束请求
+	CameraStateMap states_;		//< 各JFoV相机的最新结果
+	int latest_;				//< 最近更新的JFoV相机句柄
+};
+
+#endif /* RELPOS_DAEMON_H_ */
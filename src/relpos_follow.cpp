@@ -0,0 +1,189 @@
+/*
+ Name        : relpos_follow.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 跟踪增长中的指向文件
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include "relpos_follow.h"
+
+/*
+ * 两个文件的增长可能不同步(如一次追加一批记录), 较快文件的记录应等待较慢
+ * 文件, 因此不按窗口丢弃. 缓存的FFoV历史仍按JFoV进度裁剪
+ */
+RelPosFollow::RelPosFollow() : stop_(false) {
+	log_ = stdout;
+	window_ = FOLLOW_WINDOW;
+	ifd_ = -1;
+}
+
+RelPosFollow::~RelPosFollow() {
+	CloseAll();
+}
+
+void RelPosFollow::Stop() {
+	stop_ = true;
+}
+
+void RelPosFollow::CloseAll() {
+	for (size_t i = 0; i < files_.size(); ++i) {
+		if (files_[i].fd >= 0) close(files_[i].fd);
+	}
+	files_.clear();
+	for (CameraOutputMap::iterator it = outputs_.begin(); it != outputs_.end(); ++it) {
+		if (it->second.fp) fclose(it->second.fp);
+	}
+	outputs_.clear();
+	if (ifd_ >= 0) close(ifd_);
+	ifd_ = -1;
+}
+
+/*
+ * 结果文件名在首个结果写出时确定, 之后由Publish()随时间范围更名
+ */
+void RelPosFollow::Emit(const StreamPoint& jp, const CrossRecord& ptc, double rot0, double tilt0) {
+	CameraOutput& output = outputs_[jp.cam];
+	if (!output.fp) {
+		const CameraSlot& slot = slots_[jp.cam];
+		output.path = ResultPath(cameras_.Name(jp.cam), slot.first, slot.last);
+		output.reported = 0;
+		if (!(output.fp = fopen(output.path.c_str(), "w"))) {
+			LogPrint(log_, "failed to create result file<%s>\n", output.path.c_str());
+			return;
+		}
+		OutputHeader(output.fp);
+	}
+	OutputCross(output.fp, ptc, rot0, tilt0);
+	output.stat.Add(ptc.rot, ptc.tilt);
+}
+
+/*
+ * 文件被截短(如被重新生成)时, 丢弃偏移从头读取. 已输出的结果保留
+ */
+void RelPosFollow::ReadAppended(FollowFile& file) {
+	struct stat st;
+	char chunk[65536];
+	ssize_t len;
+
+	if (fstat(file.fd, &st)) return;
+	if (st.st_size < file.offset) {
+		LogPrint(log_, "file<%s> is truncated, read from the beginning\n", file.path.c_str());
+		lseek(file.fd, 0, SEEK_SET);
+		file.offset = 0;
+		file.buff.clear();
+	}
+	while ((len = read(file.fd, chunk, sizeof(chunk))) > 0) {
+		FeedChunk(file.buff, chunk, len);
+		file.offset += len;
+	}
+}
+
+void RelPosFollow::Publish() {
+	for (CameraOutputMap::iterator it = outputs_.begin(); it != outputs_.end(); ++it) {
+		CameraOutput& output = it->second;
+		if (!output.fp) continue;
+
+		const CameraSlot& slot = slots_[it->first];
+		string path = ResultPath(cameras_.Name(it->first), slot.first, slot.last);
+		if (path != output.path && !rename(output.path.c_str(), path.c_str())) output.path = path;
+		fflush(output.fp);
+
+		const CrossStat& stat = output.stat;
+		if (stat.n > output.reported) {
+			double rmean, rrms, tmean, trms;
+			stat.Summary(rmean, rrms, tmean, trms);
+			LogPrint(log_, "file<%s>: %d points, rotation %.2f +- %.2f, tilt %.2f +- %.2f\n",
+					output.path.c_str(), stat.n, rmean, rrms, tmean, trms);
+			output.reported = stat.n;
+		}
+	}
+	fflush(log_);
+}
+
+/*
+ * 每次唤醒(inotify事件或超时)检查全部文件长度, 以免遗漏事件. 文件被删除或
+ * 移走时读完剩余内容后停止跟踪. 文件仍被打开时删除只产生IN_ATTRIB, 由链接数判断
+ */
+bool RelPosFollow::Follow(const vector<string>& paths) {
+	int n = paths.size(), nopen(0), i;
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+	CloseAll();
+	stop_ = false;
+	if ((ifd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+		LogPrint(log_, "fail to initialize inotify\n");
+		return false;
+	}
+	for (i = 0; i < n; ++i) {
+		FollowFile file;
+		file.path   = paths[i];
+		file.offset = 0;
+		file.fd     = open(paths[i].c_str(), O_RDONLY);
+		file.wd     = -1;
+		if (file.fd < 0 || (file.wd = inotify_add_watch(ifd_, file.path.c_str(),
+				IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)) < 0) {
+			LogPrint(log_, "fail to follow file<%s>\n", paths[i].c_str());
+			if (file.fd >= 0) close(file.fd);
+			CloseAll();
+			return false;
+		}
+		files_.push_back(file);
+		++nopen;
+	}
+
+	LogPrint(log_, "following %d files, press Ctrl+C to stop\n", n);
+	while (nopen && !stop_) {
+		for (i = 0; i < n; ++i) {
+			if (files_[i].fd >= 0) ReadAppended(files_[i]);
+		}
+		Publish();
+
+		struct pollfd pfd;
+		pfd.fd = ifd_;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, FOLLOW_POLL) <= 0) continue;
+
+		ssize_t len = read(ifd_, events, sizeof(events));
+		for (char* ptr = events; len > 0 && ptr < events + len; ) {
+			const struct inotify_event* event = (const struct inotify_event*) ptr;
+			ptr += sizeof(struct inotify_event) + event->len;
+			if (!(event->mask & (IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF))) continue;
+
+			for (i = 0; i < n; ++i) {
+				FollowFile& file = files_[i];
+				struct stat st;
+				if (file.wd != event->wd || file.fd < 0) continue;
+				if (event->mask & IN_ATTRIB && !fstat(file.fd, &st) && st.st_nlink) continue;
+				LogPrint(log_, "file<%s> is removed, stop following\n", file.path.c_str());
+				ReadAppended(file);
+				close(file.fd);
+				file.fd = -1;
+				--nopen;
+			}
+		}
+	}
+
+	for (i = 0; i < n; ++i) {// 读取结束前追加的内容, 等待中的JFoV按已有数据确定匹配
+		FollowFile& file = files_[i];
+		if (file.fd >= 0) ReadAppended(file);
+		if (!file.buff.empty()) Feed(file.buff.data(), file.buff.data() + file.buff.size());
+	}
+	Flush();
+	Publish();
+	for (CameraOutputMap::iterator it = outputs_.begin(); it != outputs_.end(); ++it) {
+		if (it->second.fp) {
+			LogPrint(log_, "---------- results are saved as file<%s> ----------\n", it->second.path.c_str());
+			it->second.stat.Output(log_);
+		}
+	}
+	CloseAll();
+
+	return true;
+}
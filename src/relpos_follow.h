@@ -0,0 +1,85 @@
+/*
+ Name        : relpos_follow.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 跟踪增长中的指向文件
+ 由inotify监视输入文件, 记录已读取的字节偏移, 只解析新追加的行.
+ 新确定的交叉数据点追加到结果文件, 结果文件名随JFoV结束时间更名,
+ 统计量逐点累加. 每帧新数据的处理代价与文件长度无关
+ */
+
+#ifndef RELPOS_FOLLOW_H_
+#define RELPOS_FOLLOW_H_
+
+#include <atomic>
+#include <map>
+#include <sys/types.h>
+#include "relpos_stream.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/// 宏定义
+#define FOLLOW_POLL		1000	// 无事件时检查文件的周期, 量纲: 毫秒
+#define FOLLOW_WINDOW	1000000000	// 历史窗口, 量纲: 0.01秒. 远大于一夜, 即不按窗口丢弃
+
+class RelPosFollow : public RelPosStream {// 跟踪增长中的指向文件
+public:
+	RelPosFollow();
+	virtual ~RelPosFollow();
+
+public:
+	/*!
+	 * @brief 跟踪文件直至Stop()或全部文件被删除/移走
+	 * @param paths 输入文件路径
+	 * @return
+	 * 全部文件可以打开且可以监视时返回true
+	 * @note
+	 * 先读取文件已有内容, 再处理追加内容. 文件被截短时从头重新读取
+	 */
+	bool Follow(const vector<string>& paths);
+	/*!
+	 * @brief 请求结束跟踪
+	 * @note
+	 * 可在信号处理函数中调用
+	 */
+	void Stop();
+
+protected:
+	struct FollowFile {// 被跟踪的文件
+		string path;	//< 文件路径
+		int fd;			//< 文件描述符. <0时不再跟踪
+		int wd;			//< inotify监视描述符
+		off_t offset;	//< 已读取的字节偏移
+		string buff;	//< 不完整行的缓存
+	};
+	typedef vector<FollowFile> FollowFileV;
+
+	struct CameraOutput {// JFoV相机的结果文件
+		string path;	//< 结果文件名
+		FILE* fp;		//< 结果文件
+		CrossStat stat;	//< 统计量
+		int reported;	//< 已输出过程信息时的数据点数量
+	};
+	typedef std::map<int, CameraOutput> CameraOutputMap;
+
+	/*!
+	 * @brief 读取文件新追加的内容
+	 */
+	void ReadAppended(FollowFile& file);
+	/*!
+	 * @brief 结果文件按JFoV时间范围更名, 写出缓存并输出统计
+	 */
+	void Publish();
+	/*!
+	 * @brief 关闭全部文件
+	 */
+	void CloseAll();
+	virtual void Emit(const StreamPoint& jp, const CrossRecord& ptc, double rot0, double tilt0);
+
+protected:
+	std::atomic<bool> stop_;	//< 结束请求
+	int ifd_;					//< inotify描述符
+	FollowFileV files_;			//< 被跟踪的文件
+	CameraOutputMap outputs_;	//< 各JFoV相机的结果文件
+};
+
+#endif /* RELPOS_FOLLOW_H_ */
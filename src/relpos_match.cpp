@@ -0,0 +1,43 @@
+/*
+ Name        : relpos_match.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : JFoV与FFoV数据点的时间匹配策略
+ */
+
+#include <string.h>
+#include "relpos_match.h"
+
+static const char* policy_names[] = {"nearest", "previous", "next", "interp", "knearest"};
+
+bool MatchPolicyByName(const char* name, MatchPolicy& policy) {
+	int n = sizeof(policy_names) / sizeof(policy_names[0]), i;
+	for (i = 0; i < n && strcmp(name, policy_names[i]); ++i);
+	if (i == n) return false;
+	policy = (MatchPolicy) i;
+	return true;
+}
+
+const char* MatchPolicyName(MatchPolicy policy) {
+	return policy_names[policy];
+}
+
+void WeightedDirection(int m, int width, const PointFile& ffov, const int* pos, const double* w,
+		double* ra0, double* dc0) {
+	double x, y, z, sx, sy, sz, r;
+	int i, j, k;
+
+	for (i = 0, k = 0; i < m; ++i) {
+		sx = sy = sz = 0.0;
+		for (j = 0; j < width; ++j, ++k) {
+			if (w[k] <= 0.0) continue;
+			Sphere2Cart(1.0, ffov.ra[pos[k]] * D2R, ffov.dc[pos[k]] * D2R, x, y, z);
+			sx += w[k] * x;
+			sy += w[k] * y;
+			sz += w[k] * z;
+		}
+		Cart2Sphere(sx, sy, sz, r, ra0[i], dc0[i]);
+		ra0[i] *= R2D;
+		dc0[i] *= R2D;
+	}
+}
@@ -0,0 +1,261 @@
+/*
+ Name        : relpos_match.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : JFoV与FFoV数据点的时间匹配策略
+ 匹配策略为模板类, 容差等参数为模板参数. 扫描循环按策略实例化, 循环内不按
+ 策略分支. 各策略以单调前进的游标查找, 对按时间排序的查询保持归并扫描的
+ O(n1+n2)复杂度
+ 策略接口:
+   Width            : 每个匹配使用的FFoV数据点数量上限
+   Scratch          : Reference()每个匹配所需的临时double数量
+   Policy(index)    : 绑定FFoV时间索引
+   Seek(key)        : 游标定位到key附近, 用于数据段起点
+   Find(key, pos, w): 查找匹配, 输出Width个FFoV数据点位置及权重, 未使用的权重为0
+   Reference(...)   : 由匹配的数据点及权重批量计算参考方向, 临时空间由调用者提供
+ */
+
+#ifndef RELPOS_MATCH_H_
+#define RELPOS_MATCH_H_
+
+#include <stdlib.h>
+#include "relpos_math.h"
+#include "relpos_point.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/// 宏定义
+#define MATCH_TOL	1000		// 匹配时间容差, 量纲: 0.01秒
+#define INTERP_GAP	6000		// 插值时FFoV相邻数据点的最大间隔, 量纲: 0.01秒
+#define KNEAREST_K	4			// 加权匹配使用的FFoV数据点数量
+
+enum MatchPolicy {// 预实例化的匹配策略
+	MATCH_NEAREST,		// 容差内时间最接近的数据点
+	MATCH_PREVIOUS,		// 容差内时间不晚于JFoV的最近数据点
+	MATCH_NEXT,			// 容差内时间不早于JFoV的最近数据点
+	MATCH_INTERP,		// 前后相邻两个数据点的球面插值, 无法插值时退回最接近
+	MATCH_KNEAREST		// 容差内时间最接近的K个数据点, 按时间差倒数加权平均方向
+};
+
+/*!
+ * @brief 由名称查找匹配策略
+ * @param name   名称: nearest, previous, next, interp, knearest
+ * @param policy 匹配策略
+ * @return
+ * 名称有效时返回true
+ */
+bool MatchPolicyByName(const char* name, MatchPolicy& policy);
+/*!
+ * @brief 匹配策略的名称
+ */
+const char* MatchPolicyName(MatchPolicy policy);
+/*!
+ * @brief 批量计算加权平均方向
+ * @param m     匹配数量
+ * @param width 每个匹配的数据点数量
+ * @param ffov  FFoV文件数据
+ * @param pos   数据点位置, m*width个
+ * @param w     权重, m*width个
+ * @param ra0   平均方向赤经, 量纲: 角度
+ * @param dc0   平均方向赤纬, 量纲: 角度
+ * @note
+ * 对单位矢量加权求和后归一化
+ */
+void WeightedDirection(int m, int width, const PointFile& ffov, const int* pos, const double* w,
+		double* ra0, double* dc0);
+
+//////////////////////////////////////////////////////////////////////////////
+/// 匹配策略
+struct MatchSingle {// 单个数据点匹配的公共部分
+	enum {Width = 1, Scratch = 0};
+
+public:
+	/*!
+	 * @brief 参考方向即匹配数据点的方向
+	 */
+	static void Reference(int m, const PointFile& ffov, const int* pos, const double*,
+			double* ra0, double* dc0, double*) {
+		for (int i = 0; i < m; ++i) {
+			ra0[i] = ffov.ra[pos[i]];
+			dc0[i] = ffov.dc[pos[i]];
+		}
+	}
+};
+
+template <int Tol = MATCH_TOL>
+class MatchNearest : public MatchSingle {// 时间最接近, 时间差相同时取后一个
+public:
+	explicit MatchNearest(const TimeIndex& index) : index_(index), cursor_(0) {}
+
+	void Seek(TimeStamp key) {
+		if ((cursor_ = index_.LowerBound(key)) > 0) --cursor_;
+	}
+
+	bool Find(TimeStamp key, int* pos, double* w) {
+		if ((pos[0] = index_.Nearest(key, Tol, cursor_)) < 0) return false;
+		w[0] = 1.0;
+		return true;
+	}
+
+protected:
+	const TimeIndex& index_;	//< FFoV时间索引
+	int cursor_;				//< 索引游标
+};
+
+template <int Tol = MATCH_TOL>
+class MatchPrevious : public MatchSingle {// 时间不晚于JFoV, 时间相同时取最后一个
+public:
+	explicit MatchPrevious(const TimeIndex& index) : index_(index), cursor_(0) {}
+
+	void Seek(TimeStamp key) {
+		if ((cursor_ = index_.LowerBound(key)) > 0) --cursor_;
+	}
+
+	bool Find(TimeStamp key, int* pos, double* w) {
+		const vector<TimeStamp>& keys = index_.keys;
+		int n = keys.size();
+		if (!n) return false;
+
+		while (cursor_ + 1 < n && keys[cursor_ + 1] <= key) ++cursor_;
+		if (keys[cursor_] > key || key - keys[cursor_] > Tol) return false;
+		pos[0] = index_.pos[cursor_];
+		w[0] = 1.0;
+		return true;
+	}
+
+protected:
+	const TimeIndex& index_;	//< FFoV时间索引
+	int cursor_;				//< 索引游标
+};
+
+template <int Tol = MATCH_TOL>
+class MatchNext : public MatchSingle {// 时间不早于JFoV, 时间相同时取第一个
+public:
+	explicit MatchNext(const TimeIndex& index) : index_(index), cursor_(0) {}
+
+	void Seek(TimeStamp key) {
+		cursor_ = index_.LowerBound(key);
+	}
+
+	bool Find(TimeStamp key, int* pos, double* w) {
+		const vector<TimeStamp>& keys = index_.keys;
+		int n = keys.size();
+
+		while (cursor_ < n && keys[cursor_] < key) ++cursor_;
+		if (cursor_ == n || keys[cursor_] - key > Tol) return false;
+		pos[0] = index_.pos[cursor_];
+		w[0] = 1.0;
+		return true;
+	}
+
+protected:
+	const TimeIndex& index_;	//< FFoV时间索引
+	int cursor_;				//< 索引游标
+};
+
+template <int Gap = INTERP_GAP, int Tol = MATCH_TOL>
+class MatchInterp {// 前后相邻两个数据点的球面插值
+public:
+	enum {Width = 2, Scratch = 3};
+
+public:
+	explicit MatchInterp(const TimeIndex& index) : index_(index), bracket_(0), nearest_(index) {}
+
+	void Seek(TimeStamp key) {
+		if ((bracket_ = index_.LowerBound(key)) > 0) --bracket_;
+		nearest_.Seek(key);
+	}
+
+	/*!
+	 * @note
+	 * 权重为(1-f, f), f为插值系数. 退回最接近匹配时两个数据点相同, f=0
+	 */
+	bool Find(TimeStamp key, int* pos, double* w) {
+		double f = index_.Bracket(key, Gap, bracket_, pos[0], pos[1]);
+		if (f < 0.0) {
+			if (!nearest_.Find(key, pos, w)) return false;
+			pos[1] = pos[0];
+			f = 0.0;
+		}
+		w[0] = 1.0 - f;
+		w[1] = f;
+		return true;
+	}
+
+	static void Reference(int m, const PointFile& ffov, const int* pos, const double* w,
+			double* ra0, double* dc0, double* scratch) {
+		double *ra1 = scratch, *dc1 = ra1 + m, *frac = dc1 + m;
+		for (int i = 0; i < m; ++i) {
+			ra0[i]  = ffov.ra[pos[2 * i]];
+			dc0[i]  = ffov.dc[pos[2 * i]];
+			ra1[i]  = ffov.ra[pos[2 * i + 1]];
+			dc1[i]  = ffov.dc[pos[2 * i + 1]];
+			frac[i] = w[2 * i + 1];
+		}
+		SlerpBatch(m, ra0, dc0, ra1, dc1, frac, ra0, dc0);
+	}
+
+protected:
+	const TimeIndex& index_;		//< FFoV时间索引
+	int bracket_;					//< 插值查找的索引游标
+	MatchNearest<Tol> nearest_;		//< 无法插值时的最接近匹配
+};
+
+template <int K = KNEAREST_K, int Tol = MATCH_TOL>
+class MatchKNearest {// 时间最接近的K个数据点, 按时间差倒数加权
+public:
+	enum {Width = K, Scratch = 0};
+
+public:
+	explicit MatchKNearest(const TimeIndex& index) : index_(index), cursor_(0) {}
+
+	void Seek(TimeStamp key) {
+		if ((cursor_ = index_.LowerBound(key)) > 0) --cursor_;
+	}
+
+	/*!
+	 * @note
+	 * 从key前后两侧向外逐个选取较近的数据点. 权重为1/(1+|dt|), dt量纲为0.01秒,
+	 * 归一化后和为1
+	 */
+	bool Find(TimeStamp key, int* pos, double* w) {
+		const vector<TimeStamp>& keys = index_.keys;
+		int n = keys.size(), lo, hi, k;
+		double sum(0.0);
+		if (!n) return false;
+
+		while (cursor_ + 1 < n && keys[cursor_ + 1] <= key) ++cursor_;
+		lo = keys[cursor_] <= key ? cursor_ : cursor_ - 1;
+		hi = lo + 1;
+		for (k = 0; k < K; ++k) {
+			bool left = lo >= 0 && key - keys[lo] <= Tol;
+			bool right = hi < n && keys[hi] - key <= Tol;
+			int i;
+			if (left && right) i = key - keys[lo] < keys[hi] - key ? lo-- : hi++;
+			else if (left) i = lo--;
+			else if (right) i = hi++;
+			else break;
+			pos[k] = index_.pos[i];
+			sum += (w[k] = 1.0 / (1.0 + llabs(keys[i] - key)));
+		}
+		if (!k) return false;
+		for (int j = 0; j < K; ++j) {
+			if (j < k) w[j] /= sum;
+			else {
+				pos[j] = pos[0];
+				w[j] = 0.0;
+			}
+		}
+		return true;
+	}
+
+	static void Reference(int m, const PointFile& ffov, const int* pos, const double* w,
+			double* ra0, double* dc0, double*) {
+		WeightedDirection(m, K, ffov, pos, w, ra0, dc0);
+	}
+
+protected:
+	const TimeIndex& index_;	//< FFoV时间索引
+	int cursor_;				//< 索引游标
+};
+
+#endif /* RELPOS_MATCH_H_ */
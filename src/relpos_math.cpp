@@ -0,0 +1,241 @@
+/*
+ Name        : relpos_math.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 球坐标变换, 包括单点变换与批量变换
+ */
+
+#include "relpos_math.h"
+
+void Sphere2Cart(double r, double alpha, double beta, double& x, double& y, double& z)
+{
+	x = r * cos(beta) * cos(alpha);
+	y = r * cos(beta) * sin(alpha);
+	z = r * sin(beta);
+}
+
+void Cart2Sphere(double x, double y, double z, double& r, double& alpha, double& beta)
+{
+	r = sqrt(x * x + y * y + z * z);
+	if ((alpha = atan2(y, x)) < 0) alpha += PI360;
+	beta  = atan2(z, sqrt(x * x + y * y));
+}
+
+void RotateForward(double alpha0, double beta0, double& alpha, double& beta)
+{
+	RotateMatrix rmat;
+	rmat.Set(alpha0, beta0);
+	rmat.Forward(alpha, beta);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// 批量坐标变换
+/*
+ * 以GCC向量扩展实现的sincos/atan2核, 每次处理BATCH_WIDTH个数据点.
+ * 在x86-64上为AVX-512/AVX2/SSE4.2分别生成代码, 由运行时CPU类型选择.
+ * 多项式系数取自Cephes数学库.
+ * 误差界: 与libm相比, 正弦/余弦/反正切误差不超过2 ULP.
+ * 与标量路径(RotateMatrix::Forward)相比, tilt之差不超过1E-13度, rot之差不超过
+ * 1E-13/sin(tilt)度. tilt趋于0时rot本身病态, 两条路径的差异来自输入舍入
+ * @note
+ * sqrt的向量化依赖-fno-math-errno
+ */
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+#define BATCH_TARGETS	__attribute__((target_clones("avx512f", "avx2", "sse4.2", "default")))
+#else
+#define BATCH_TARGETS
+#endif
+#define BATCH_WIDTH		8	// 批处理宽度
+#define BATCH_INLINE	static inline __attribute__((always_inline))
+
+typedef double VecD __attribute__((vector_size(BATCH_WIDTH * sizeof(double))));
+typedef long long VecL __attribute__((vector_size(BATCH_WIDTH * sizeof(long long))));
+
+/*!
+ * @brief 同时计算正弦与余弦
+ * @param x 角度, 量纲: 弧度
+ * @param s 正弦
+ * @param c 余弦
+ */
+BATCH_INLINE void SinCosBatch(const VecD& x, VecD& s, VecD& c) {
+	const double DP1 = 7.85398125648498535156E-1;	// PI/4分为三段
+	const double DP2 = 3.77489470793079817668E-8;
+	const double DP3 = 2.69515142907905952645E-15;
+	const double FOPI = 1.27323954473516268615;		// 4/PI
+
+	VecL neg = x < 0.0;
+	VecD ax = neg ? -x : x;
+	VecL j = __builtin_convertvector(ax * FOPI, VecL);
+	j += j & 1;		// 映射到[-PI/4, PI/4]
+	VecD y = __builtin_convertvector(j, VecD);
+	VecD z = ((ax - y * DP1) - y * DP2) - y * DP3;
+	VecD zz = z * z;
+	VecD ps = z + z * zz * (((((1.58962301576546568060E-10 * zz
+			- 2.50507477628578072866E-8) * zz
+			+ 2.75573136213857245213E-6) * zz
+			- 1.98412698295895385996E-4) * zz
+			+ 8.33333333332211858878E-3) * zz
+			- 1.66666666666666307295E-1);
+	VecD pc = 1.0 - 0.5 * zz + zz * zz * (((((-1.13585365213876817300E-11 * zz
+			+ 2.08757008419747316778E-9) * zz
+			- 2.75573141792967388112E-7) * zz
+			+ 2.48015872888517045348E-5) * zz
+			- 1.38888888888730564116E-3) * zz
+			+ 4.16666666666665929218E-2);
+	VecL swap = (j & 2) != 0;		// 象限1和3交换正弦与余弦
+	VecL half = (j & 4) != 0;		// 象限2和3取反
+
+	s = swap ? pc : ps;
+	s = (half ^ neg) ? -s : s;
+	c = swap ? ps : pc;
+	c = (half ^ swap) ? -c : c;
+}
+
+/*!
+ * @brief 计算反正切
+ * @param y 纵坐标
+ * @param x 横坐标
+ * @param r 反正切, 量纲: 弧度, 范围: [-PI, PI]
+ */
+BATCH_INLINE void Atan2Batch(const VecD& y, const VecD& x, VecD& r) {
+	const double PIO4 = 7.85398163397448309616E-1;
+	const double PIO2 = 1.57079632679489661923;
+	const double MOREBITS = 6.123233995736765886130E-17;	// PI/2的低位
+
+	VecD ay = y < 0.0 ? -y : y;
+	VecD ax = x < 0.0 ? -x : x;
+	VecL swap = ay > ax;
+	VecD mn = swap ? ax : ay;
+	VecD mx = swap ? ay : ax;
+	VecD a = mx > 0.0 ? mn / mx : mx * 0.0;	// a ∈ [0, 1]
+
+	// atan(a)
+	VecL big = a > 0.66;
+	VecD t = big ? (a - 1.0) / (a + 1.0) : a;
+	VecD z = t * t;
+	z = z * ((((-8.750608600031904122785E-1 * z
+			- 1.615753718733365076637E1) * z
+			- 7.500855792314704667340E1) * z
+			- 1.228866684490136173410E2) * z
+			- 6.485021904942025371773E1)
+		/ (((((z + 2.485846490142306297962E1) * z
+			+ 1.650270098316988542046E2) * z
+			+ 4.328810604912902668951E2) * z
+			+ 4.853903996359136964868E2) * z
+			+ 1.945506571482613964425E2);
+	z = t * z + t;
+	z = big ? PIO4 + (z + 0.5 * MOREBITS) : z;
+
+	// 恢复象限
+	z = swap ? (PIO2 - z) + MOREBITS : z;
+	z = x < 0.0 ? (API - z) + 2.0 * MOREBITS : z;
+	r = y < 0.0 ? -z : z;
+}
+
+BATCH_TARGETS
+void RelativeBatch(int n, const double* ra, const double* dc, const double* ra0, const double* dc0,
+		double* rot, double* tilt) {
+	VecD a1, b1, a0, b0;	// 输入
+	VecD sa1, ca1, sb1, cb1, sa0, ca0, sb0, cb0;
+	VecD x1, y1, z1, x2, y2, z2, rr, rho, r, t;
+	VecD zero = {0};
+	int i, k, m, size;
+
+	for (i = 0; i < n; i += BATCH_WIDTH) {
+		m = n - i < BATCH_WIDTH ? n - i : BATCH_WIDTH;
+		size = m * sizeof(double);
+		if (m < BATCH_WIDTH) a1 = b1 = a0 = b0 = zero;
+		memcpy(&a1, ra + i, size);
+		memcpy(&b1, dc + i, size);
+		memcpy(&a0, ra0 + i, size);
+		memcpy(&b0, dc0 + i, size);
+
+		SinCosBatch(a1 * D2R, sa1, ca1);
+		SinCosBatch(b1 * D2R, sb1, cb1);
+		SinCosBatch(a0 * D2R, sa0, ca0);
+		SinCosBatch(b0 * D2R, sb0, cb0);
+
+		x1 = cb1 * ca1;
+		y1 = cb1 * sa1;
+		z1 = sb1;
+		x2 = (sb0 * ca0) * x1 + (sb0 * sa0) * y1 - cb0 * z1;
+		y2 = -sa0 * x1 + ca0 * y1;
+		z2 = (cb0 * ca0) * x1 + (cb0 * sa0) * y1 + sb0 * z1;
+
+		rr = x2 * x2 + y2 * y2;
+		for (k = 0; k < BATCH_WIDTH; ++k) rho[k] = sqrt(rr[k]);
+		Atan2Batch(y2, x2, r);
+		Atan2Batch(z2, rho, t);
+		r = r < 0.0 ? r + PI360 : r;
+		r = r < PI360 ? r : r - PI360;	// 负零附近的舍入
+		r = r * R2D;
+		t = 90.0 - t * R2D;
+
+		memcpy(rot + i, &r, size);
+		memcpy(tilt + i, &t, size);
+	}
+}
+
+/*
+ * 夹角由atan2(|p0×p1|, p0·p1)计算, 小角度时仍准确. 夹角接近0时退化为线性插值
+ */
+BATCH_TARGETS
+void SlerpBatch(int n, const double* ra0, const double* dc0, const double* ra1, const double* dc1,
+		const double* frac, double* ra, double* dc) {
+	VecD a0, b0, a1, b1, f;	// 输入
+	VecD sa0, ca0, sb0, cb0, sa1, ca1, sb1, cb1;
+	VecD x0, y0, z0, x1, y1, z1, cx, cy, cz, sn, cs, theta;
+	VecD s0, c0, s1, c1, w0, w1, x, y, z, rr, rho, r, t;
+	VecD zero = {0};
+	int i, k, m, size;
+
+	for (i = 0; i < n; i += BATCH_WIDTH) {
+		m = n - i < BATCH_WIDTH ? n - i : BATCH_WIDTH;
+		size = m * sizeof(double);
+		if (m < BATCH_WIDTH) a0 = b0 = a1 = b1 = f = zero;
+		memcpy(&a0, ra0 + i, size);
+		memcpy(&b0, dc0 + i, size);
+		memcpy(&a1, ra1 + i, size);
+		memcpy(&b1, dc1 + i, size);
+		memcpy(&f, frac + i, size);
+
+		SinCosBatch(a0 * D2R, sa0, ca0);
+		SinCosBatch(b0 * D2R, sb0, cb0);
+		SinCosBatch(a1 * D2R, sa1, ca1);
+		SinCosBatch(b1 * D2R, sb1, cb1);
+		x0 = cb0 * ca0;
+		y0 = cb0 * sa0;
+		z0 = sb0;
+		x1 = cb1 * ca1;
+		y1 = cb1 * sa1;
+		z1 = sb1;
+
+		cx = y0 * z1 - z0 * y1;
+		cy = z0 * x1 - x0 * z1;
+		cz = x0 * y1 - y0 * x1;
+		rr = cx * cx + cy * cy + cz * cz;
+		for (k = 0; k < BATCH_WIDTH; ++k) sn[k] = sqrt(rr[k]);
+		cs = x0 * x1 + y0 * y1 + z0 * z1;
+		Atan2Batch(sn, cs, theta);
+		SinCosBatch((1.0 - f) * theta, s0, c0);
+		SinCosBatch(f * theta, s1, c1);
+		// 单位矢量叉积的模即sin(theta)
+		w0 = sn > 1E-12 ? s0 / sn : 1.0 - f;
+		w1 = sn > 1E-12 ? s1 / sn : f;
+
+		x = w0 * x0 + w1 * x1;
+		y = w0 * y0 + w1 * y1;
+		z = w0 * z0 + w1 * z1;
+		rr = x * x + y * y;
+		for (k = 0; k < BATCH_WIDTH; ++k) rho[k] = sqrt(rr[k]);
+		Atan2Batch(y, x, r);
+		Atan2Batch(z, rho, t);
+		r = r < 0.0 ? r + PI360 : r;
+		r = r < PI360 ? r : r - PI360;	// 负零附近的舍入
+
+		r = r * R2D;
+		t = t * R2D;
+		memcpy(ra + i, &r, size);
+		memcpy(dc + i, &t, size);
+	}
+}
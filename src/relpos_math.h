@@ -0,0 +1,106 @@
+/*
+ Name        : relpos_math.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 球坐标变换, 包括单点变换与批量变换
+ */
+
+#ifndef RELPOS_MATH_H_
+#define RELPOS_MATH_H_
+
+#include <math.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////////
+/// 宏定义
+#define API		3.141592653589793
+#define PI360	6.283185307179586
+#define D2R		0.017453292519943		// 使用乘法, 角度转换为弧度的系数
+#define R2D		57.295779513082323		// 使用乘法, 弧度转换为角度的系数
+
+void Sphere2Cart(double r, double alpha, double beta, double& x, double& y, double& z);
+void Cart2Sphere(double x, double y, double z, double& r, double& alpha, double& beta);
+
+struct RotateMatrix {// 坐标系旋转矩阵
+	double m[3][3];
+
+public:
+	RotateMatrix() {
+		memset(m, 0, sizeof(m));
+	}
+
+	/*!
+	 * @brief 由新坐标系极轴计算旋转矩阵
+	 * @param alpha0 极轴在原坐标系中的经度, 量纲: 弧度
+	 * @param beta0  极轴在原坐标系中的纬度, 量纲: 弧度
+	 */
+	void Set(double alpha0, double beta0) {
+		double sa = sin(alpha0), ca = cos(alpha0);
+		double sb = sin(beta0), cb = cos(beta0);
+
+		/*! 对直角坐标做旋转变换. 定义矢量V=(alpha0, beta0)
+		 * 主动视角, 旋转矢量V
+		 * 先绕Z轴逆时针旋转: -alpha0, 将矢量V旋转至XZ平面
+		 * 再绕Y轴逆时针旋转: -(PI90 - beta0), 将矢量V旋转至与Z轴重合
+		 **/
+		m[0][0] = sb * ca;	m[0][1] = sb * sa;	m[0][2] = -cb;
+		m[1][0] = -sa;		m[1][1] = ca;		m[1][2] = 0.0;
+		m[2][0] = cb * ca;	m[2][1] = cb * sa;	m[2][2] = sb;
+	}
+
+	/*!
+	 * @brief 将原坐标系中的位置转换到新坐标系
+	 * @param alpha 经度, 量纲: 弧度
+	 * @param beta  纬度, 量纲: 弧度
+	 */
+	void Forward(double& alpha, double& beta) const {
+		double r = 1.0;
+		double x1, y1, z1;	// 原坐标系投影位置
+		double x2, y2, z2;	// 新坐标系投影位置
+
+		Sphere2Cart(r, alpha, beta, x1, y1, z1);
+		x2 = m[0][0] * x1 + m[0][1] * y1 + m[0][2] * z1;
+		y2 = m[1][0] * x1 + m[1][1] * y1;
+		z2 = m[2][0] * x1 + m[2][1] * y1 + m[2][2] * z1;
+		Cart2Sphere(x2, y2, z2, r, alpha, beta);
+	}
+};
+
+/*!
+ * @brief 将位置转换到以(alpha0, beta0)为极轴的新球坐标系
+ * @note
+ * 同一极轴需转换多个位置时, 应复用RotateMatrix
+ */
+void RotateForward(double alpha0, double beta0, double& alpha, double& beta);
+
+/*!
+ * @brief 批量计算JFoV相对FFoV的旋转角与倾斜角
+ * @param n    数据点数量
+ * @param ra   JFoV赤经, 量纲: 角度
+ * @param dc   JFoV赤纬, 量纲: 角度
+ * @param ra0  FFoV赤经, 量纲: 角度
+ * @param dc0  FFoV赤纬, 量纲: 角度
+ * @param rot  旋转角, 量纲: 角度
+ * @param tilt 倾斜角, 量纲: 角度
+ * @note
+ * 计算过程与RotateMatrix::Forward一致
+ */
+void RelativeBatch(int n, const double* ra, const double* dc, const double* ra0, const double* dc0,
+		double* rot, double* tilt);
+/*!
+ * @brief 批量计算两个方向间的球面线性插值(SLERP)
+ * @param n    数据点数量
+ * @param ra0  起点赤经, 量纲: 角度
+ * @param dc0  起点赤纬, 量纲: 角度
+ * @param ra1  终点赤经, 量纲: 角度
+ * @param dc1  终点赤纬, 量纲: 角度
+ * @param frac 插值系数, 0对应起点, 1对应终点
+ * @param ra   插值方向赤经, 范围[0, 360), 量纲: 角度
+ * @param dc   插值方向赤纬, 量纲: 角度
+ * @note
+ * 插值方向沿两点间大圆弧匀速移动
+ */
+void SlerpBatch(int n, const double* ra0, const double* dc0, const double* ra1, const double* dc1,
+		const double* frac, double* ra, double* dc);
+
+#endif /* RELPOS_MATH_H_ */
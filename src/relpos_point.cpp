@@ -0,0 +1,409 @@
+/*
+ Name        : relpos_point.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 指向文件的解析与数据点集合
+ */
+
+#include <algorithm>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "relpos_point.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/// MappedFile
+void MappedFile::Swap(MappedFile& other) {
+	std::swap(data_, other.data_);
+	std::swap(size_, other.size_);
+	std::swap(mapped_, other.mapped_);
+	buff_.swap(other.buff_);
+}
+
+bool MappedFile::Open(const string& filepath) {
+	Close();
+
+	int fd = open(filepath.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (!fstat(fd, &st) && S_ISREG(st.st_mode)) {
+		if (st.st_size > 0) {
+			void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (addr != MAP_FAILED) {
+				madvise(addr, st.st_size, MADV_SEQUENTIAL);
+				data_   = (const char*) addr;
+				size_   = st.st_size;
+				mapped_ = true;
+			}
+		}
+		else data_ = "";
+	}
+	if (!data_) {// 逐块读入
+		char block[65536];
+		ssize_t n;
+		while ((n = read(fd, block, sizeof(block))) > 0) buff_.insert(buff_.end(), block, block + n);
+		data_ = buff_.empty() ? "" : &buff_[0];
+		size_ = buff_.size();
+	}
+	close(fd);
+
+	return true;
+}
+
+void MappedFile::Close() {
+	if (mapped_) munmap((void*) data_, size_);
+	data_   = NULL;
+	size_   = 0;
+	mapped_ = false;
+	buff_.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// TimeIndex
+void TimeIndex::Build(const vector<TimeStamp>& times) {
+	int n = times.size(), i;
+	bool ordered(true);
+
+	keys = times;
+	pos.resize(n);
+	for (i = 0; i < n; ++i) {
+		pos[i] = i;
+		if (i && keys[i] < keys[i - 1]) ordered = false;
+	}
+	if (ordered) return;
+
+	RadixSortTime(times, pos);
+	for (i = 0; i < n; ++i) keys[i] = times[pos[i]];
+}
+
+int TimeIndex::LowerBound(TimeStamp key) const {
+	int lo(0), hi(keys.size()), mid, probe;
+
+	for (probe = 0; probe < 4 && hi - lo > 16 && keys[lo] < key && key <= keys[hi - 1]; ++probe) {
+		mid = lo + (int) ((double) (key - keys[lo]) * (hi - 1 - lo) / (keys[hi - 1] - keys[lo]));
+		if (keys[mid] < key) lo = mid + 1;
+		else hi = mid;
+	}
+
+	return std::lower_bound(keys.begin() + lo, keys.begin() + hi, key) - keys.begin();
+}
+
+int TimeIndex::Nearest(TimeStamp key, int tol) const {
+	int n = keys.size(), i;
+	if (!n) return -1;
+
+	if ((i = LowerBound(key)) == n || (i > 0 && key - keys[i - 1] < keys[i] - key)) --i;
+	else for (; i + 1 < n && keys[i + 1] == keys[i]; ++i);
+
+	return (llabs(keys[i] - key) > tol ? -1 : pos[i]);
+}
+
+int TimeIndex::Nearest(TimeStamp key, int tol, int& cursor) const {
+	int n = keys.size();
+	if (!n) return -1;
+
+	while (cursor + 1 < n && llabs(key - keys[cursor + 1]) <= llabs(key - keys[cursor]))
+		++cursor;
+
+	return (llabs(keys[cursor] - key) > tol ? -1 : pos[cursor]);
+}
+
+double TimeIndex::Bracket(TimeStamp key, int gap, int& cursor, int& lo, int& hi) const {
+	int n = keys.size();
+	if (!n) return -1.0;
+
+	while (cursor + 1 < n && keys[cursor + 1] <= key) ++cursor;
+	if (keys[cursor] > key) return -1.0;
+	if (keys[cursor] == key) {
+		lo = hi = pos[cursor];
+		return 0.0;
+	}
+	if (cursor + 1 == n || keys[cursor + 1] - keys[cursor] > gap) return -1.0;
+
+	lo = pos[cursor];
+	hi = pos[cursor + 1];
+	return (double) (key - keys[cursor]) / (keys[cursor + 1] - keys[cursor]);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// PointFile
+void PointFile::Reset() {
+	cid.clear();
+	cam = -1;
+	time.clear();
+	ra.clear();
+	dc.clear();
+	names.clear();
+	index.keys.clear();
+	index.pos.clear();
+	stat = ResolveStat();
+	src.Close();
+}
+
+/*
+ * 按排列收集到新列后交换, 每列一次顺序写入
+ */
+template <class T>
+static void Permute(vector<T>& col, const vector<int>& order) {
+	int n = order.size(), i;
+	vector<T> sorted(n);
+	for (i = 0; i < n; ++i) sorted[i] = col[order[i]];
+	col.swap(sorted);
+}
+
+bool PointFile::SortByTime() {
+	int n = time.size(), i;
+	for (i = 1; i < n; ++i) {
+		if (time[i] < time[i - 1]) ++stat.disorder;
+	}
+	if (!stat.disorder) return false;
+
+	vector<int> order;
+	RadixSortTime(time, order);
+	Permute(time, order);
+	Permute(ra, order);
+	Permute(dc, order);
+	Permute(names, order);
+	return true;
+}
+
+void PointFile::Swap(PointFile& other) {
+	cid.swap(other.cid);
+	std::swap(cam, other.cam);
+	time.swap(other.time);
+	ra.swap(other.ra);
+	dc.swap(other.dc);
+	names.swap(other.names);
+	index.keys.swap(other.index.keys);
+	index.pos.swap(other.index.pos);
+	std::swap(stat, other.stat);
+	src.Swap(other.src);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/*
+ * 键与原位置成对分配到桶中, 同一桶内保持上一趟的顺序, 因此排序稳定
+ */
+void RadixSortTime(const vector<TimeStamp>& times, vector<int>& order) {
+	const int nbucket = 1 << RADIX_BITS;
+	const unsigned long long mask = nbucket - 1;
+	int n = times.size(), i, shift;
+	TimeStamp tmin, tmax;
+
+	order.resize(n);
+	for (i = 0; i < n; ++i) order[i] = i;
+	if (n < 2) return;
+	tmin = tmax = times[0];
+	for (i = 1; i < n; ++i) {
+		if (tmin > times[i]) tmin = times[i];
+		else if (tmax < times[i]) tmax = times[i];
+	}
+
+	unsigned long long range = tmax - tmin;
+	vector<unsigned long long> key(n), key2(n);
+	vector<int> order2(n), count(nbucket + 1);
+	for (i = 0; i < n; ++i) key[i] = times[i] - tmin;
+	for (shift = 0; shift < 64 && (range >> shift); shift += RADIX_BITS) {
+		count.assign(nbucket + 1, 0);
+		for (i = 0; i < n; ++i) ++count[((key[i] >> shift) & mask) + 1];
+		for (i = 1; i < nbucket; ++i) count[i] += count[i - 1];
+		for (i = 0; i < n; ++i) {
+			int j = count[(key[i] >> shift) & mask]++;
+			key2[j]   = key[i];
+			order2[j] = order[i];
+		}
+		key.swap(key2);
+		order.swap(order2);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// 解析函数
+TextSpan NextToken(const char*& ptr, const char* end, const char* seps) {
+	for (; ptr < end && strchr(seps, *ptr); ++ptr);
+	const char* start = ptr;
+	for (; ptr < end && !strchr(seps, *ptr); ++ptr);
+	return TextSpan(start, ptr - start);
+}
+
+/*
+ * 有效数字不超过2^53且十进制指数不超过22时, 尾数与10的幂均可精确表示,
+ * 一次乘除即得到正确舍入的结果. 其它情况交由strtod处理
+ */
+bool SpanToDouble(const TextSpan& token, double& val) {
+	static const double pow10[] = {
+		1E0,  1E1,  1E2,  1E3,  1E4,  1E5,  1E6,  1E7,  1E8,  1E9,  1E10, 1E11,
+		1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22
+	};
+	const char* ptr = token.ptr;
+	const char* end = ptr + token.len;
+	unsigned long long mant(0);	// 尾数
+	int exp10(0);	// 十进制指数
+	int nd(0);		// 数字个数
+	bool neg(false), exact(true);
+
+	if (ptr < end && (*ptr == '-' || *ptr == '+')) neg = *ptr++ == '-';
+	for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ++ptr, ++nd) {
+		if (mant < 100000000000000000ULL) mant = mant * 10 + (*ptr - '0');
+		else {
+			++exp10;
+			exact = false;
+		}
+	}
+	if (ptr < end && *ptr == '.') {
+		for (++ptr; ptr < end && *ptr >= '0' && *ptr <= '9'; ++ptr, ++nd) {
+			if (mant < 100000000000000000ULL) {
+				mant = mant * 10 + (*ptr - '0');
+				--exp10;
+			}
+			else exact = false;
+		}
+	}
+	if (!nd) return false;
+	if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+		int e(0), ne(0);
+		bool eneg(false);
+
+		if (++ptr < end && (*ptr == '-' || *ptr == '+')) eneg = *ptr++ == '-';
+		for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ++ptr, ++ne) {
+			if (e < 10000) e = e * 10 + (*ptr - '0');
+		}
+		if (!ne) return false;
+		exp10 += eneg ? -e : e;
+	}
+	if (ptr != end) return false;
+
+	if (exact && mant <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+		val = exp10 < 0 ? mant / pow10[-exp10] : mant * pow10[exp10];
+		if (neg) val = -val;
+	}
+	else {// 慢速路径
+		char buff[64];
+		if (token.len >= (int) sizeof(buff)) return false;
+		memcpy(buff, token.ptr, token.len);
+		buff[token.len] = 0;
+		val = strtod(buff, NULL);
+	}
+
+	return true;
+}
+
+bool ResolveLine(const char* line, const char* end, double& ra, double& dc, TextSpan& fname, ResolveStat& stat) {
+	const char seps[] = " \t\r\n";
+	TextSpan tra, tdc;
+
+	if (!(tra = NextToken(line, end, seps)).len) return false;
+	++stat.lines;
+	tdc   = NextToken(line, end, seps);
+	fname = NextToken(line, end, seps);
+	if (!fname.len) {
+		++stat.fields;
+		return false;
+	}
+	if (!(SpanToDouble(tra, ra) && SpanToDouble(tdc, dc))) {
+		++stat.number;
+		return false;
+	}
+	return true;
+}
+
+bool MakeTimeStamp(int ymd, int hms, TimeStamp& t) {
+	int y = 2000 + ymd / 10000, m = ymd / 100 % 100, d = ymd % 100;
+	int hh = hms / 1000000, mm = hms / 10000 % 100, ss = hms % 10000;
+	if (m < 1 || m > 12 || d < 1 || d > 31 || hh > 23 || mm > 59 || ss >= 6000) return false;
+
+	// 公历日期转换为1970-01-01起的日数
+	y -= m <= 2;
+	int era = y / 400;
+	int yoe = y - era * 400;
+	int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	long long days = era * 146097LL + doe - 719468;
+
+	t = (days * 1440 + hh * 60 + mm) * 6000 + ss;
+	return true;
+}
+
+/*
+ * 文件名格式: G<cam_id>_<imgtypabbr>_<utc>.fit
+ * cam_id位于首个'_'之前, utc位于最后一个'_'之后, 按固定布局逐字符解码
+ */
+bool ResolveFilename(const TextSpan& fname, CameraTable& cameras, int& cam, TimeStamp& t) {
+	static const char layout[] = "DDDDDDTDDDDDDDD.fit";	// utc及扩展名布局, D为数字
+	static const int fields[][2] = {// 数值字段在utc中的偏移与长度
+		{0, 6},	// 年月日
+		{7, 8}		// 时分秒
+	};
+	const int nlayout = sizeof(layout) - 1;
+	const char* ptr = fname.ptr;
+	const char* end = fname.ptr + fname.len;
+	const char* sep1;	// 首个'_'
+	const char* utc;	// utc起始位置
+	int val[2], i, j;
+
+	if (fname.len < nlayout + 3 || *ptr != 'G') return false;
+	utc = end - nlayout;
+	if (utc[-1] != '_' || !(sep1 = (const char*) memchr(ptr, '_', utc - ptr)) || sep1 == ptr + 1)
+		return false;
+	for (i = 0; i < nlayout; ++i) {
+		if (layout[i] == 'D' ? (unsigned) (utc[i] - '0') > 9 : utc[i] != layout[i]) return false;
+	}
+	for (i = 0; i < 2; ++i) {
+		for (j = 0, val[i] = 0; j < fields[i][1]; ++j)
+			val[i] = val[i] * 10 + (utc[fields[i][0] + j] - '0');
+	}
+	if (!MakeTimeStamp(val[0], val[1], t)) return false;
+
+	cam = cameras.Intern(ptr + 1, sep1 - ptr - 1);
+	return true;
+}
+
+/*
+ * 行数为数据点数量的上限, 各列按此一次分配
+ */
+static int CountLines(const char* ptr, const char* end) {
+	int n(1);
+	for (; (ptr = (const char*) memchr(ptr, '\n', end - ptr)); ++ptr, ++n);
+	return n;
+}
+
+/*
+ * 文件内容以只读方式映射, 在映射区内原位分行解析
+ */
+bool LoadPointFile(const string& filepath, PointFile& ptf, CameraTable& cameras) {
+	ptf.Reset();
+	if (!ptf.src.Open(filepath)) return false;
+
+	const char* data = ptf.src.Data();
+	const char* line = data;	// 行起始位置
+	const char* end  = line + ptf.src.Size();
+	const char* eol;	// 行结束位置
+	double ra, dc;	// 赤经/赤纬
+	TextSpan fname;	// 文件名
+	int cam;		// 相机标志句柄
+	TimeStamp t;	// 时间
+
+	ptf.Reserve(CountLines(data, end));
+	for (; line < end; line = eol + 1) {
+		if (!(eol = (const char*) memchr(line, '\n', end - line))) eol = end;
+		if (!ResolveLine(line, eol, ra, dc, fname, ptf.stat)) continue;
+		if (!ResolveFilename(fname, cameras, cam, t)) {
+			++ptf.stat.fname;
+			continue;
+		}
+		if (ptf.cam < 0) {
+			ptf.cam = cam;
+			ptf.cid = cameras.Name(cam);
+		}
+
+		NameRef name = {(size_t) (fname.ptr - data), fname.len};
+		ptf.Append(t, ra, dc, name);
+	}
+	ptf.SortByTime();
+	ptf.BuildIndex();
+
+	return true;
+}
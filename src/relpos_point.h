@@ -0,0 +1,368 @@
+/*
+ Name        : relpos_point.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 指向文件的解析与数据点集合
+ 文件内容分为三列, 分别对应: 赤经 赤纬 FITS文件名
+ 赤经/赤纬: 量纲: 角度
+ 文 件 名:  G<cam_id>_<imgtypabbr>_<utc>.fit
+           cam_id : 相机标志, 三字节字符串
+           imgtypabbr: 图像类型缩写
+           utc    : UTC时间, 格式: YYMMDDThhmmssfs, fs量纲为10毫秒
+ */
+
+#ifndef RELPOS_POINT_H_
+#define RELPOS_POINT_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <string.h>
+
+using std::string;
+using std::vector;
+
+//////////////////////////////////////////////////////////////////////////////
+/// 宏定义
+#define RADIX_BITS	11		// 基数排序每趟的位数
+
+//////////////////////////////////////////////////////////////////////////////
+/// 数据结构
+typedef long long TimeStamp;	//< UTC时间戳, 自1970-01-01起的时间, 量纲: 0.01秒
+
+struct TextSpan {// 文本片段, 不拥有所指内容
+	const char* ptr;	//< 起始地址
+	int len;			//< 长度
+
+public:
+	TextSpan() : ptr(NULL), len(0) {}
+	TextSpan(const char* p, int n) : ptr(p), len(n) {}
+};
+
+class MappedFile {// 只读映射的文件内容
+public:
+	MappedFile() : data_(NULL), size_(0), mapped_(false) {}
+	virtual ~MappedFile() {
+		Close();
+	}
+
+	/*!
+	 * @brief 交换两个对象的文件内容
+	 * @note
+	 * 交换后原有内容的地址不变
+	 */
+	void Swap(MappedFile& other);
+	/*!
+	 * @brief 打开文件并映射全部内容
+	 * @param filepath 文件路径
+	 * @return
+	 * 打开结果
+	 * @note
+	 * 无法映射的文件(如管道)退化为一次性读入内存
+	 */
+	bool Open(const string& filepath);
+	/*!
+	 * @brief 解除映射
+	 */
+	void Close();
+
+	const char* Data() const {
+		return data_;
+	}
+
+	size_t Size() const {
+		return size_;
+	}
+
+protected:
+	const char* data_;	//< 文件内容
+	size_t size_;		//< 文件长度
+	bool mapped_;		//< 内容是否为内存映射
+	vector<char> buff_;	//< 无法映射时的读入缓存
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+class CameraTable {// 相机标志驻留表
+public:
+	/*!
+	 * @brief 查找或登记相机标志
+	 * @param ptr 相机标志起始地址
+	 * @param len 相机标志长度
+	 * @return
+	 * 相机标志句柄
+	 */
+	int Intern(const char* ptr, int len) {
+		int n = ids_.size(), i;
+		if (last_ >= 0 && Equal(last_, ptr, len)) return last_;
+		for (i = 0; i < n && !Equal(i, ptr, len); ++i);
+		if (i == n) ids_.push_back(string(ptr, len));
+		return (last_ = i);
+	}
+
+	/*!
+	 * @brief 查看句柄对应的相机标志
+	 */
+	const string& Name(int cam) const {
+		return ids_[cam];
+	}
+
+protected:
+	bool Equal(int cam, const char* ptr, int len) const {
+		return ((int) ids_[cam].size() == len && !memcmp(ids_[cam].data(), ptr, len));
+	}
+
+protected:
+	vector<string> ids_;	//< 已登记的相机标志
+	int last_;				//< 最近查找的句柄
+
+public:
+	CameraTable() : last_(-1) {}
+};
+
+struct NameRef {// 文件名在源文件中的位置
+	size_t pos;	//< 偏移
+	int len;		//< 长度
+};
+typedef vector<NameRef> NameRefV;
+
+struct TimeIndex {// 时间索引
+	vector<TimeStamp> keys;	//< 时间, 升序排列
+	vector<int> pos;	//< 与keys对应的数据点位置
+
+public:
+	/*!
+	 * @brief 由数据点时间建立索引
+	 * @param times 数据点时间
+	 * @note
+	 * 数据点已按时间顺序排列时, 直接顺序建立; 否则对索引项基数排序
+	 */
+	void Build(const vector<TimeStamp>& times);
+	/*!
+	 * @brief 查找第一个时间不小于key的索引项
+	 * @param key 时间
+	 * @return
+	 * 索引项位置. 所有时间都小于key时返回索引长度
+	 * @note
+	 * 数据点时间间隔大致均匀, 先以插值探测缩小区间, 再做二分查找
+	 */
+	int LowerBound(TimeStamp key) const;
+	/*!
+	 * @brief 查找与时间最接近的数据点
+	 * @param key 时间
+	 * @param tol 时间容差, 量纲: 0.01秒
+	 * @return
+	 * 匹配数据点位置
+	 *  -1: 未找到匹配数据
+	 * >=0: 匹配数据位置
+	 * @note
+	 * 时间差相同时取后一个数据点
+	 */
+	int Nearest(TimeStamp key, int tol) const;
+	/*!
+	 * @brief 按游标查找与时间最接近的数据点
+	 * @param key    时间
+	 * @param tol    时间容差, 量纲: 0.01秒
+	 * @param cursor 索引游标. 输入: 起始扫描位置; 输出: 最接近索引项位置
+	 * @return
+	 * 匹配数据点位置
+	 *  -1: 未找到匹配数据
+	 * >=0: 匹配数据位置
+	 * @note
+	 * 适用于key单调不减的连续查询. 游标单调前进, 总代价为O(n1+n2)
+	 */
+	int Nearest(TimeStamp key, int tol, int& cursor) const;
+	/*!
+	 * @brief 按游标查找时间前后相邻的两个数据点
+	 * @param key    时间
+	 * @param gap    两个数据点的最大时间间隔, 量纲: 0.01秒
+	 * @param cursor 索引游标. 输入: 起始扫描位置; 输出: 时间不大于key的最后索引项位置
+	 * @param lo     时间不大于key的数据点位置
+	 * @param hi     时间不小于key的数据点位置
+	 * @return
+	 * 插值系数(key - t_lo) / (t_hi - t_lo), 范围[0, 1]
+	 * <0: key超出索引时间范围, 或两个数据点间隔超过gap
+	 * @note
+	 * 时间与key相同时lo与hi为同一数据点, 插值系数为0. 适用于key单调不减的连续查询
+	 */
+	double Bracket(TimeStamp key, int gap, int& cursor, int& lo, int& hi) const;
+};
+
+struct ResolveStat {// 文件解析统计
+	int lines;		//< 非空行数
+	int fields;		//< 字段不足的行数
+	int number;		//< 赤经/赤纬格式错误的行数
+	int fname;		//< 文件名格式错误的行数
+	int disorder;	//< 时间早于前一数据点的数据点数量
+
+public:
+	ResolveStat() : lines(0), fields(0), number(0), fname(0), disorder(0) {}
+
+	/*!
+	 * @brief 被丢弃的行数
+	 */
+	int Rejected() const {
+		return fields + number + fname;
+	}
+};
+
+struct PointFile {// 文件数据点, 按列存储
+	string cid;		//< 相机标志
+	int cam;		//< 相机标志句柄
+	vector<TimeStamp> time;	//< 时间
+	vector<double> ra;	//< 赤经, 量纲: 角度
+	vector<double> dc;	//< 赤纬, 量纲: 角度
+	NameRefV names;	//< 文件名
+	TimeIndex index;	//< 时间索引
+	ResolveStat stat;	//< 解析统计
+	MappedFile src;	//< 源文件内容, 文件名引用其中的字节
+
+public:
+	PointFile() : cam(-1) {}
+
+	/*!
+	 * @brief 数据点数量
+	 */
+	int Size() const {
+		return time.size();
+	}
+
+	/*!
+	 * @brief 为数据点预留存储空间
+	 * @param n 数据点数量
+	 */
+	void Reserve(int n) {
+		time.reserve(n);
+		ra.reserve(n);
+		dc.reserve(n);
+		names.reserve(n);
+	}
+
+	/*!
+	 * @brief 追加数据点
+	 * @param t     时间
+	 * @param alpha 赤经, 量纲: 角度
+	 * @param beta  赤纬, 量纲: 角度
+	 * @param name  文件名位置
+	 */
+	void Append(TimeStamp t, double alpha, double beta, const NameRef& name) {
+		time.push_back(t);
+		ra.push_back(alpha);
+		dc.push_back(beta);
+		names.push_back(name);
+	}
+
+	/*!
+	 * @brief 查看数据点的文件名
+	 * @param i 数据点位置
+	 */
+	TextSpan Filename(int i) const {
+		return TextSpan(src.Data() + names[i].pos, names[i].len);
+	}
+
+	/*!
+	 * @brief 清除已解析的数据
+	 */
+	void Reset();
+	/*!
+	 * @brief 交换两个对象的全部数据
+	 */
+	void Swap(PointFile& other);
+
+	/*!
+	 * @brief 将数据点按时间稳定排序
+	 * @return
+	 * 数据点原来不按时间顺序排列时返回true
+	 * @note
+	 * 乱序数据点数量计入stat.disorder. 各列按同一排列重排, 文件名仍引用源文件内容
+	 */
+	bool SortByTime();
+	/*!
+	 * @brief 建立时间索引
+	 */
+	void BuildIndex() {
+		index.Build(time);
+	}
+
+	virtual ~PointFile() {
+		Reset();
+	}
+};
+typedef std::shared_ptr<const PointFile> PointFilePtr;	//< 可在会话间共享的文件数据
+
+//////////////////////////////////////////////////////////////////////////////
+/*!
+ * @brief 按时间稳定排序
+ * @param times 时间
+ * @param order 排序结果, order[i]为第i个数据点的原位置
+ * @note
+ * 低位优先基数排序, 以相对最早时间的偏移为键, 每趟RADIX_BITS位, 趟数由时间
+ * 跨度决定. 一夜观测的跨度约需3趟, 代价为O(n)
+ */
+void RadixSortTime(const vector<TimeStamp>& times, vector<int>& order);
+
+//////////////////////////////////////////////////////////////////////////////
+/// 解析函数
+/*!
+ * @brief 从扫描位置取下一个字段
+ * @param ptr  扫描位置. 返回时指向字段之后
+ * @param end  扫描结束位置
+ * @param seps 分隔符
+ * @return
+ * 字段. 无字段时长度为0
+ */
+TextSpan NextToken(const char*& ptr, const char* end, const char* seps);
+/*!
+ * @brief 将字段转换为浮点数
+ * @param token 字段
+ * @param val   转换结果
+ * @return
+ * 字段为完整的十进制浮点数时返回true
+ */
+bool SpanToDouble(const TextSpan& token, double& val);
+/*!
+ * @brief 解析行信息
+ * @param line  行起始位置
+ * @param end   行结束位置
+ * @param ra    赤经
+ * @param dc    赤纬
+ * @param fname 文件名, 指向行内容
+ * @param stat  解析统计
+ * @return
+ * 行解析结果. 空行或格式错误时返回false, 错误计入stat
+ */
+bool ResolveLine(const char* line, const char* end, double& ra, double& dc, TextSpan& fname, ResolveStat& stat);
+/*!
+ * @brief 由日期和时间计算时间戳
+ * @param ymd 年月日, 格式: YYMMDD, 年份为2000年后
+ * @param hms 时分秒, 格式: hhmmssfs, fs量纲为10毫秒
+ * @param t   时间戳
+ * @return
+ * 日期和时间有效时返回true
+ */
+bool MakeTimeStamp(int ymd, int hms, TimeStamp& t);
+/*!
+ * @brief 解析文件名
+ * @param fname   文件名
+ * @param cameras 相机标志驻留表
+ * @param cam     相机标志句柄
+ * @param t       时间戳
+ * @return
+ * 文件名符合格式时返回true
+ */
+bool ResolveFilename(const TextSpan& fname, CameraTable& cameras, int& cam, TimeStamp& t);
+/*!
+ * @brief 解析指向文件
+ * @param filepath 文件路径
+ * @param ptf      文件数据. 原有数据被清除
+ * @param cameras  相机标志驻留表
+ * @return
+ * 文件可以打开时返回true. 解析得到的数据点数量为ptf.Size()
+ * @note
+ * 相机标志取自第一个有效数据点. 解析完成后数据点按时间排序, 并建立时间索引
+ */
+bool LoadPointFile(const string& filepath, PointFile& ptf, CameraTable& cameras);
+
+#endif /* RELPOS_POINT_H_ */
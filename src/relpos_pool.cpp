@@ -0,0 +1,103 @@
+/*
+ Name        : relpos_pool.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 工作窃取线程池
+ */
+
+#include "relpos_pool.h"
+
+static thread_local WorkPool* tls_pool = NULL;	// 当前线程所属线程池
+static thread_local int tls_id = -1;			// 当前线程在线程池中的编号
+
+WorkPool::WorkPool(int nthread) : queued_(0) {
+	pending_ = 0;
+	next_ = 0;
+	stop_ = false;
+
+	if (nthread <= 0) nthread = std::thread::hardware_concurrency();
+	if (nthread <= 0) nthread = 1;
+	for (int i = 0; i < nthread; ++i) workers_.push_back(std::unique_ptr<Worker>(new Worker));
+	for (int i = 0; i < nthread; ++i) threads_.push_back(std::thread(&WorkPool::Run, this, i));
+}
+
+WorkPool::~WorkPool() {
+	Wait();
+	{
+		std::unique_lock<std::mutex> lck(mtx_);
+		stop_ = true;
+	}
+	cv_work_.notify_all();
+	for (size_t i = 0; i < threads_.size(); ++i) threads_[i].join();
+}
+
+/*
+ * 计数在任务入队后增加, 在mtx_内修改, 以免工作线程错过唤醒
+ */
+void WorkPool::Submit(const Task& task) {
+	int id;
+	{
+		std::unique_lock<std::mutex> lck(mtx_);
+		++pending_;
+		if (tls_pool == this) id = tls_id;
+		else {
+			id = next_;
+			next_ = (next_ + 1) % workers_.size();
+		}
+	}
+	{
+		Worker* worker = workers_[id].get();
+		std::unique_lock<std::mutex> lck(worker->mtx);
+		worker->tasks.push_back(task);
+	}
+	{
+		std::unique_lock<std::mutex> lck(mtx_);
+		++queued_;
+	}
+	cv_work_.notify_one();
+}
+
+void WorkPool::Wait() {
+	std::unique_lock<std::mutex> lck(mtx_);
+	cv_idle_.wait(lck, [this]() { return pending_ == 0; });
+}
+
+bool WorkPool::Pop(int id, Task& task) {
+	int n = workers_.size(), i;
+	for (i = 0; i < n; ++i) {
+		Worker* worker = workers_[(id + i) % n].get();
+		std::unique_lock<std::mutex> lck(worker->mtx);
+		if (worker->tasks.empty()) continue;
+		if (i == 0) {
+			task = worker->tasks.back();
+			worker->tasks.pop_back();
+		}
+		else {
+			task = worker->tasks.front();
+			worker->tasks.pop_front();
+		}
+		--queued_;
+		return true;
+	}
+	return false;
+}
+
+void WorkPool::Run(int id) {
+	tls_pool = this;
+	tls_id = id;
+
+	Task task;
+	while (true) {
+		if (Pop(id, task)) {
+			task();
+			task = Task();
+			std::unique_lock<std::mutex> lck(mtx_);
+			if (--pending_ == 0) cv_idle_.notify_all();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lck(mtx_);
+		cv_work_.wait(lck, [this]() { return stop_ || queued_ > 0; });
+		if (stop_ && queued_ <= 0) break;
+	}
+}
@@ -0,0 +1,93 @@
+/*
+ Name        : relpos_pool.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 工作窃取线程池
+ 每个工作线程拥有独立的任务队列. 线程优先从自身队列尾部取任务,
+ 自身队列为空时从其它线程队列头部窃取任务
+ */
+
+#ifndef RELPOS_POOL_H_
+#define RELPOS_POOL_H_
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+class WorkPool {// 工作窃取线程池
+public:
+	typedef std::function<void()> Task;	//< 任务
+
+public:
+	/*!
+	 * @brief 创建线程池并启动工作线程
+	 * @param nthread 工作线程数量. <=0时取处理器数量
+	 */
+	explicit WorkPool(int nthread = 0);
+	virtual ~WorkPool();
+
+public:
+	/*!
+	 * @brief 提交任务
+	 * @param task 任务
+	 * @note
+	 * 在工作线程内提交的任务进入该线程的队列, 否则依次分配给各线程
+	 */
+	void Submit(const Task& task);
+	/*!
+	 * @brief 等待已提交的全部任务完成
+	 * @note
+	 * 不可在工作线程内调用
+	 */
+	void Wait();
+	/*!
+	 * @brief 工作线程数量
+	 */
+	int Size() const {
+		return workers_.size();
+	}
+
+protected:
+	struct Worker {// 工作线程的任务队列
+		std::mutex mtx;			//< 队列互斥锁
+		std::deque<Task> tasks;	//< 待执行任务
+	};
+
+	/*!
+	 * @brief 工作线程主循环
+	 * @param id 工作线程编号
+	 */
+	void Run(int id);
+	/*!
+	 * @brief 取下一个任务
+	 * @param id   工作线程编号
+	 * @param task 任务
+	 * @return
+	 * 取得任务时返回true
+	 * @note
+	 * 先取自身队列尾部, 再依次窃取其它队列头部
+	 */
+	bool Pop(int id, Task& task);
+
+protected:
+	std::vector<std::unique_ptr<Worker> > workers_;	//< 各线程的任务队列
+	std::vector<std::thread> threads_;	//< 工作线程
+	std::mutex mtx_;	//< 等待/唤醒互斥锁
+	std::condition_variable cv_work_;	//< 新任务通知
+	std::condition_variable cv_idle_;	//< 任务全部完成通知
+	std::atomic<int> queued_;	//< 队列中的任务数
+	int pending_;	//< 已提交未完成的任务数
+	int next_;		//< 下一个分配任务的线程
+	bool stop_;		//< 停止标志
+
+private:
+	WorkPool(const WorkPool&);
+	WorkPool& operator=(const WorkPool&);
+};
+
+#endif /* RELPOS_POOL_H_ */
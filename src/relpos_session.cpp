@@ -0,0 +1,477 @@
+/*
+ Name        : relpos_session.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : JFoV相对FFoV位置计算会话
+ */
+
+#include <algorithm>
+#include <thread>
+#include <stdarg.h>
+#include <stdlib.h>
+#include "relpos_session.h"
+#include "relpos_clip.h"
+
+#define reduce(x, period)	((x) - floor((x) / (period)) * (period))
+
+string ResultPath(const PointFile& ptf) {
+	return ResultPath(ptf.cid, ptf.index.keys.front(), ptf.index.keys.back());
+}
+
+string ResultPath(const string& cid, TimeStamp t0, TimeStamp t1) {
+	char buff[100];
+	int m0 = t0 / 6000 % 1440;	// 日内分钟数
+	int m1 = t1 / 6000 % 1440;
+	sprintf(buff, "G%s_%02d%02d-%02d%02d.txt", cid.c_str(),
+			m0 / 60, m0 % 60, m1 / 60, m1 % 60);
+	return buff;
+}
+
+void LogPrint(FILE* fp, const char* format, ...) {
+	if (!fp) return;
+
+	va_list ap;
+	va_start(ap, format);
+	vfprintf(fp, format, ap);
+	va_end(ap);
+}
+
+void OutputHeader(FILE* fp, bool clip) {
+	fprintf(fp, "%8s %8s %33s %8s %8s %33s %5s %4s %6s %5s%s\n",
+			"R.A.  ", "DEC.  ", "FileName            ",
+			"R.A.0 ", "DEC.0 ", "FileName.0          ",
+			"Rot ", "Tilt", "rRot ", "rTilt", clip ? " Clip" : "");
+}
+
+void RelativeBase(const CrossRecord& pt, double rot0, double tilt0, double& rrot, double& rtilt) {
+	rrot = rot0 - pt.rot;
+	if (rrot > 180.0) rrot -= 360.0;
+	else if (rrot < -180.0) rrot += 360.0;
+	rtilt = tilt0 - pt.tilt;
+}
+
+void OutputCross(FILE* fp, const CrossRecord& pt, double rot0, double tilt0, int clip) {
+	double rrot, rtilt;
+	RelativeBase(pt, rot0, tilt0, rrot, rtilt);
+	fprintf(fp, "%8.4f %8.4f %33.*s %8.4f %8.4f %33.*s %5.1f %4.1f %6.1f %5.1f",
+			pt.ra, pt.dc, pt.fname.len, pt.fname.ptr,
+			pt.ra0, pt.dc0, pt.fname0.len, pt.fname0.ptr,
+			pt.rot, pt.tilt, rrot, rtilt);
+	if (clip >= 0) fprintf(fp, " %4d\n", clip);
+	else fprintf(fp, "\n");
+}
+
+/*
+ * 倾斜角均值与离差平方和的合并采用Chan等的成对公式. 旋转角范围由other的
+ * 参考角换算到本组参考角
+ */
+void CrossStat::Merge(const CrossStat& other) {
+	if (!other.n) return;
+	if (!n) {
+		*this = other;
+		return;
+	}
+
+	double shift = Deviate(other.rref, rref);
+	double n1 = n, n2 = other.n, nsum = n1 + n2;
+	double dt = other.tmean - tmean;
+
+	rsin  += other.rsin;
+	rcos  += other.rcos;
+	tmean += dt * n2 / nsum;
+	tm2   += other.tm2 + dt * dt * n1 * n2 / nsum;
+	if (rmin > other.rmin + shift) rmin = other.rmin + shift;
+	if (rmax < other.rmax + shift) rmax = other.rmax + shift;
+	if (tmin > other.tmin) tmin = other.tmin;
+	if (tmax < other.tmax) tmax = other.tmax;
+	rsketch.Merge(other.rsketch, shift);
+	tsketch.Merge(other.tsketch);
+	n += other.n;
+}
+
+double CrossStat::Resultant() const {
+	double r = n ? sqrt(rsin * rsin + rcos * rcos) / n : 0.0;
+	return r > 1.0 ? 1.0 : r;
+}
+
+void CrossStat::Summary(double& rmean, double& rrms, double& tmean, double& trms) const {
+	rmean = reduce(atan2(rsin, rcos) * R2D, 360.0);
+	rrms  = sqrt(-2.0 * log(Resultant())) * R2D;
+	tmean = this->tmean;
+	trms  = sqrt(tm2 / n);
+}
+
+void CrossStat::Range(double& rmin, double& rmax) const {
+	rmin = reduce(rref + this->rmin, 360.0);
+	rmax = reduce(rref + this->rmax, 360.0);
+}
+
+void CrossStat::Quantile(double q, double& rot, double& tilt) const {
+	rot  = reduce(rref + rsketch.Quantile(q), 360.0);
+	tilt = tsketch.Quantile(q);
+}
+
+void CrossStat::Output(FILE* fp) const {
+	if (!n) return;
+
+	double rmean, rrms, tmean, trms, rlo, rhi;
+	double rmed, r01, r99, tmed, t01, t99;
+	Summary(rmean, rrms, tmean, trms);
+	Range(rlo, rhi);
+	Quantile(0.50, rmed, tmed);
+	Quantile(0.01, r01, t01);
+	Quantile(0.99, r99, t99);
+	fprintf(fp, "****************************** Statistical results ******************************\n");
+	fprintf(fp, "Rotation Minimum = %6.1f \t Rotation Maximum = %6.1f\n", rlo, rhi);
+	fprintf(fp, "Rotation Mean    = %6.2f \t Rotation Stdev   = %6.2f\n", rmean, rrms);
+	fprintf(fp, "Resultant Length = %6.4f\n", Resultant());
+	fprintf(fp, "Rotation Median  = %6.2f \t Rotation 1%%-99%% = %6.2f - %6.2f\n", rmed, r01, r99);
+	fprintf(fp, "Tilt Minimum     = %6.1f \t Tilt Maximum     = %6.1f\n", tmin, tmax);
+	fprintf(fp, "Tilt Mean        = %6.2f \t Tilt Stdev       = %6.2f\n", tmean, trms);
+	fprintf(fp, "Tilt Median      = %6.2f \t Tilt 1%%-99%%     = %6.2f - %6.2f\n", tmed, t01, t99);
+	fprintf(fp, "****************************** Statistical results ******************************\n");
+}
+
+RelPosSession::RelPosSession() : arena_(ARENA_HUGE, true) {
+	log_   = stdout;
+	rot0_  = 0.0;
+	tilt0_ = 0.0;
+	nthread_ = 0;
+	nsigma_  = 0.0;
+	policy_  = MATCH_NEAREST;
+	nrejected_ = 0;
+	niter_   = 0;
+}
+
+RelPosSession::~RelPosSession() {
+	pt_cross_.clear();
+}
+
+void RelPosSession::SetLog(FILE* fp) {
+	log_ = fp;
+}
+
+void RelPosSession::SetBase(double rot, double tilt) {
+	rot0_  = rot;
+	tilt0_ = tilt;
+}
+
+void RelPosSession::SetThreads(int n) {
+	if (n != nthread_) pool_.reset();
+	nthread_ = n;
+}
+
+void RelPosSession::SetTopology(const MountTopology& topo) {
+	topo_ = topo;
+}
+
+void RelPosSession::SetClip(double nsigma) {
+	nsigma_ = nsigma;
+}
+
+void RelPosSession::SetPolicy(MatchPolicy policy) {
+	policy_ = policy;
+}
+
+bool RelPosSession::ResolveFile(const string& filepath) {
+	LogPrint(log_, "\n");
+
+	std::shared_ptr<PointFile> ptf(new PointFile);
+	if (!LoadPointFile(filepath, *ptf, cameras_)) return false;
+	LogPrint(log_, "---------- Resolving file: %s ----------\n", filepath.c_str());
+
+	int n = ptf->Size();
+	CameraRole role;
+	bool known = n && topo_.Classify(ptf->cid, role);
+	if (known) LogPrint(log_, "file<%s> is considered to be from %s\n", filepath.c_str(), role.ffov ? "FFoV" : "JFoV");
+	else if (n) LogPrint(log_, "camera<%s> of file<%s> is not found in topology\n", ptf->cid.c_str(), filepath.c_str());
+
+	const ResolveStat& stat = ptf->stat;
+	LogPrint(log_, "%d points are resolved from file\n", n);
+	if (stat.Rejected()) {
+		LogPrint(log_, "%d of %d lines are rejected: %d short, %d bad coordinate, %d bad file name\n",
+				stat.Rejected(), stat.lines, stat.fields, stat.number, stat.fname);
+	}
+	if (stat.disorder) LogPrint(log_, "%d points are out of time order, sorted by time\n", stat.disorder);
+
+	if (!known) return false;
+	if (!role.ffov && role.based) SetBase(role.rot0, role.tilt0);
+
+	return Attach(ptf, role.ffov);
+}
+
+bool RelPosSession::Attach(const PointFilePtr& ptf, bool ffov) {
+	if (!(ptf && ptf->Size())) return false;
+
+	pt_cross_.clear();
+	if (ffov) pt_ffov_ = ptf;
+	else {
+		pathDst_ = ResultPath(*ptf);
+		pt_jfov_ = ptf;
+	}
+
+	return true;
+}
+
+bool RelPosSession::HasJFoV() const {
+	return (bool) pt_jfov_;
+}
+
+bool RelPosSession::HasFFoV() const {
+	return (bool) pt_ffov_;
+}
+
+bool RelPosSession::TimeCrossCheck() const {
+	if (!(pt_jfov_ && pt_ffov_)) return false;
+
+	const vector<TimeStamp>& t1 = pt_jfov_->index.keys;
+	const vector<TimeStamp>& t2 = pt_ffov_->index.keys;
+	return (t1.front() <= t2.back() + MATCH_TOL && t2.front() <= t1.back() + MATCH_TOL);
+}
+
+int RelPosSession::FindMatchedData(TimeStamp key) const {
+	return pt_ffov_->index.Nearest(key, MATCH_TOL);
+}
+
+int RelPosSession::FindMatchedData(TimeStamp key, int& from) const {
+	return pt_ffov_->index.Nearest(key, MATCH_TOL, from);
+}
+
+/*
+ * 游标由二分查找定位到数据段起点附近, 段内仍为归并扫描
+ */
+template <class Policy>
+void RelPosSession::MatchChunk(ScanChunk* chunk) {
+	const TimeIndex& index = pt_jfov_->index;
+	Policy policy(pt_ffov_->index);
+	int pos[Policy::Width], i, j, best;
+	double w[Policy::Width];
+
+	if (chunk->first >= chunk->last) return;
+	policy.Seek(index.keys[chunk->first]);
+	for (i = chunk->first; i < chunk->last; ++i) {
+		if (!policy.Find(index.keys[i], pos, w)) continue;
+
+		for (j = 1, best = 0; j < Policy::Width; ++j) {// 权重相同时取后一个
+			if (w[j] >= w[best]) best = j;
+		}
+		chunk->jpos[chunk->nmatch] = index.pos[i];
+		chunk->kpos[chunk->nmatch] = pos[best];
+		if (Policy::Width > 1) {
+			std::copy(pos, pos + Policy::Width, chunk->refs + chunk->nmatch * Policy::Width);
+			std::copy(w, w + Policy::Width, chunk->weights + chunk->nmatch * Policy::Width);
+		}
+		++chunk->nmatch;
+	}
+}
+
+template <class Policy>
+void RelPosSession::RelateChunk(ScanChunk* chunk) {
+	int m = chunk->nmatch, i;
+	if (!m) return;
+
+	double *ra = chunk->buff, *dc = ra + m, *ra0 = dc + m, *dc0 = ra0 + m, *rot = dc0 + m, *tilt = rot + m;
+	for (i = 0; i < m; ++i) {
+		ra[i]  = pt_jfov_->ra[chunk->jpos[i]];
+		dc[i]  = pt_jfov_->dc[chunk->jpos[i]];
+	}
+	if (Policy::Width > 1) Policy::Reference(m, *pt_ffov_, chunk->refs, chunk->weights, ra0, dc0, tilt + m);
+	else Policy::Reference(m, *pt_ffov_, chunk->kpos, NULL, ra0, dc0, tilt + m);
+	RelativeBatch(m, ra, dc, ra0, dc0, rot, tilt);
+
+	for (i = 0; i < m; ++i) {
+		PointCross& ptc = pt_cross_[chunk->offset + i];
+		ptc.jpos = chunk->jpos[i];
+		ptc.kpos = chunk->kpos[i];
+		if (Policy::Width > 1) {
+			ref_[2 * (chunk->offset + i)]     = ra0[i];
+			ref_[2 * (chunk->offset + i) + 1] = dc0[i];
+		}
+		ptc.rot  = rot[i];
+		ptc.tilt = tilt[i];
+		chunk->stat.Add(rot[i], tilt[i]);
+	}
+}
+
+/*
+ * 全部数组所需空间按最多匹配数(JFoV数据点数)一次预留, 位于同一内存块.
+ * 数组在当前线程分配, 工作线程只写入各自数据段的区间
+ */
+template <class Policy>
+int RelPosSession::ScanWith(ScanChunkV& chunks) {
+	const int width = Policy::Width > 1 ? Policy::Width : 0;	// 每个匹配记录的数据点数量
+	const int nbuff = 6 + Policy::Scratch;	// 每个匹配的临时double数量
+	int nchunk = chunks.size(), n1 = pt_jfov_->index.keys.size(), i, n, m;
+	size_t each = 2 * sizeof(int) + width * (sizeof(int) + sizeof(double)) + nbuff * sizeof(double)
+			+ sizeof(PointCross) + (width ? 2 * sizeof(double) : 0) + sizeof(char);
+
+	if (!arena_.Reserve(each * n1 + sizeof(double) * (5 * nchunk + 3))) return -1;
+	for (i = 0; i < nchunk; ++i) {
+		ScanChunk& chunk = chunks[i];
+		n = chunk.last - chunk.first;
+		chunk.nmatch  = 0;
+		chunk.jpos    = arena_.New<int>(n);
+		chunk.kpos    = arena_.New<int>(n);
+		chunk.refs    = width ? arena_.New<int>(width * n) : NULL;
+		chunk.weights = width ? arena_.New<double>(width * n) : NULL;
+	}
+
+	RunChunks(chunks, &RelPosSession::MatchChunk<Policy>);
+	for (i = 0, m = 0; i < nchunk; ++i) {
+		chunks[i].offset = m;
+		chunks[i].buff = arena_.New<double>(nbuff * chunks[i].nmatch);
+		m += chunks[i].nmatch;
+	}
+	if (!pt_cross_.Assign(arena_, m) || (width && !ref_.Assign(arena_, 2 * m))) return -1;
+	RunChunks(chunks, &RelPosSession::RelateChunk<Policy>);
+
+	return m;
+}
+
+/*
+ * 单个数据段时在当前线程执行
+ */
+void RelPosSession::RunChunks(ScanChunkV& chunks, ScanFunc func) {
+	int n = chunks.size(), i;
+	if (n == 1) {
+		(this->*func)(&chunks[0]);
+		return;
+	}
+
+	if (!pool_) pool_.reset(new WorkPool(nthread_));
+	for (i = 0; i < n; ++i) {
+		ScanChunk* chunk = &chunks[i];
+		pool_->Submit([this, func, chunk]() { (this->*func)(chunk); });
+	}
+	pool_->Wait();
+}
+
+/*
+ * JFoV时间索引分段后由多个线程并行处理. 各段先匹配, 再按段内匹配数确定
+ * 结果位置, 最后批量计算相对位置并写入各自区间. 结果与串行扫描相同,
+ * 按JFoV时间顺序排列. 各段统计量合并为总体统计
+ */
+int RelPosSession::ScanData() {
+	LogPrint(log_, "\nscan and try to find matched data\n");
+
+	pt_cross_.clear();
+	ref_.clear();
+	rejected_.clear();
+	arena_.Reset();
+	nrejected_ = niter_ = 0;
+	stat_.Reset();
+	if (!(pt_jfov_ && pt_ffov_)) return 0;
+
+	int n1 = pt_jfov_->index.keys.size();
+	int nthread = nthread_ > 0 ? nthread_ : std::thread::hardware_concurrency();
+	int nchunk = n1 / CHUNK_MIN;
+	int i, m;
+
+	if (nchunk > nthread) nchunk = nthread;
+	if (nchunk < 1) nchunk = 1;
+	ScanChunkV chunks(nchunk);
+	for (i = 0; i < nchunk; ++i) {
+		chunks[i].first = (long long) n1 * i / nchunk;
+		chunks[i].last  = (long long) n1 * (i + 1) / nchunk;
+	}
+
+	switch (policy_) {// 按策略选择预实例化的扫描函数, 扫描循环内不再分支
+	case MATCH_PREVIOUS:
+		m = ScanWith<MatchPrevious<> >(chunks);
+		break;
+	case MATCH_NEXT:
+		m = ScanWith<MatchNext<> >(chunks);
+		break;
+	case MATCH_INTERP:
+		m = ScanWith<MatchInterp<> >(chunks);
+		break;
+	case MATCH_KNEAREST:
+		m = ScanWith<MatchKNearest<> >(chunks);
+		break;
+	default:
+		m = ScanWith<MatchNearest<> >(chunks);
+		break;
+	}
+	if (m < 0) {
+		LogPrint(log_, "fail to allocate memory for scanning\n");
+		pt_cross_.clear();
+		ref_.clear();
+		return 0;
+	}
+	for (i = 0; i < nchunk; ++i) stat_.Merge(chunks[i].stat);
+
+	LogPrint(log_, "found %d matched points\n", pt_cross_.size());
+	if (nsigma_ > 0.0 && m) Clip();
+	return m;
+}
+
+void RelPosSession::OutputResult(FILE* fp) const {
+	LogPrint(log_, "\n");
+	int n = pt_cross_.size(), i;
+	if (n == 0) return;
+
+	bool clip = nsigma_ > 0.0;
+	OutputHeader(fp, clip);
+	CrossRecord rec;
+	for (i = 0; i < n; ++i) {
+		Resolve(i, rec);
+		OutputCross(fp, rec, rot0_, tilt0_, clip ? rejected_[i] : -1);
+	}
+
+	if (fp == stdout || fp == stderr) {
+		if (clip) {
+			fprintf(fp, "Sigma clipping at %.1f sigma rejects %d of %d points in %d iterations\n",
+					nsigma_, nrejected_, n, niter_);
+		}
+		stat_.Output(fp);
+	}
+}
+
+/*
+ * 统计量由保留的数据点重新累加
+ */
+void RelPosSession::Clip() {
+	SigmaClip clip;
+	int n = pt_cross_.size(), i;
+
+	nrejected_ = clip.Run(pt_cross_, nsigma_);
+	niter_ = clip.Iterations();
+	rejected_.Assign(arena_, n);
+	stat_.Reset();
+	for (i = 0; i < n; ++i) {
+		if (!(rejected_[i] = clip.Rejected(i))) stat_.Add(pt_cross_[i].rot, pt_cross_[i].tilt);
+	}
+	LogPrint(log_, "sigma clipping rejects %d points in %d iterations\n", nrejected_, niter_);
+}
+
+const string& RelPosSession::OutputPath() const {
+	return pathDst_;
+}
+
+const PointFile& RelPosSession::JFoV() const {
+	return *pt_jfov_;
+}
+
+const PointFile& RelPosSession::FFoV() const {
+	return *pt_ffov_;
+}
+
+const PtCrossV& RelPosSession::Results() const {
+	return pt_cross_;
+}
+
+void RelPosSession::Resolve(int i, CrossRecord& rec) const {
+	const PointCross& ptc = pt_cross_[i];
+	rec.SetPoint(*pt_jfov_, ptc.jpos);
+	rec.SetPointRef(*pt_ffov_, ptc.kpos);
+	if (!ref_.empty()) {
+		rec.ra0 = ref_[2 * i];
+		rec.dc0 = ref_[2 * i + 1];
+	}
+	rec.rot  = ptc.rot;
+	rec.tilt = ptc.tilt;
+}
+
+const CrossStat& RelPosSession::Stat() const {
+	return stat_;
+}
@@ -0,0 +1,477 @@
+/*
+ Name        : relpos_session.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : JFoV相对FFoV位置计算会话
+ 会话对象拥有一对JFoV/FFoV数据及其计算结果, 不使用全局状态.
+ 不同会话对象可在多个线程中并发使用, 单个会话对象不可被多个线程同时调用
+ */
+
+#ifndef RELPOS_SESSION_H_
+#define RELPOS_SESSION_H_
+
+#include <stdio.h>
+#include "relpos_math.h"
+#include "relpos_point.h"
+#include "relpos_match.h"
+#include "relpos_topology.h"
+#include "relpos_sketch.h"
+#include "relpos_pool.h"
+#include "relpos_arena.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/// 宏定义
+#define CHUNK_MIN	4096		// 并行扫描时每段的最少JFoV数据点数
+
+//////////////////////////////////////////////////////////////////////////////
+/// 数据结构
+struct PointCross {// 交叉数据点, 以位置引用JFoV与FFoV数据点, 共24字节
+	int jpos;		//< JFoV数据点位置
+	int kpos;		//< FFoV数据点位置. 多个数据点匹配时为权重最大者
+	double rot, tilt;	//< 旋转角和倾斜角, 量纲: 角度
+};
+typedef ArenaArray<PointCross> PtCrossV;	//< 交叉数据点集合, 位于会话内存区
+
+struct CrossRecord {// 交叉数据点的完整记录, 输出时由数据点位置解析
+	double ra, dc;	//< JFoV中心位置, 量纲: 角度
+	TextSpan fname;	//< JFoV文件名
+	double ra0, dc0;	//< FFoV中心位置, 量纲: 角度
+	TextSpan fname0;	//< FFoV文件名
+	double rot, tilt;	//< 旋转角和倾斜角, 量纲: 角度
+
+public:
+	/*!
+	 * @brief 设置数据点, 即JFoV数据
+	 * @param ptf 文件数据
+	 * @param i   数据点位置
+	 */
+	void SetPoint(const PointFile& ptf, int i) {
+		ra = ptf.ra[i];
+		dc = ptf.dc[i];
+		fname = ptf.Filename(i);
+	}
+
+	/*!
+	 * @brief 设置参考点, 即FFoV数据, 不计算相对位置
+	 * @param ptf 文件数据
+	 * @param i   数据点位置
+	 */
+	void SetPointRef(const PointFile& ptf, int i) {
+		ra0 = ptf.ra[i];
+		dc0 = ptf.dc[i];
+		fname0 = ptf.Filename(i);
+	}
+
+	/*!
+	 * @brief 设置参考点, 即FFoV数据
+	 * @param ptf  文件数据
+	 * @param i    数据点位置
+	 * @param rmat 以参考点为极轴的旋转矩阵
+	 */
+	void SetPointRef(const PointFile& ptf, int i, const RotateMatrix& rmat) {
+		SetPointRef(ptf, i);
+		Relate(rmat);
+	}
+
+	/*!
+	 * @brief 由数据点位置计算相对参考点的旋转角和倾斜角
+	 * @param rmat 以参考点为极轴的旋转矩阵
+	 */
+	void Relate(const RotateMatrix& rmat) {
+		rot = ra * D2R;
+		tilt= dc * D2R;
+		rmat.Forward(rot, tilt);
+		rot *= R2D;
+		tilt = 90 - tilt * R2D;
+	}
+};
+
+struct CrossStat {// 交叉数据点的旋转角与倾斜角统计, 单遍累加, 可合并
+	int n;			//< 数据点数量
+	double rsin, rcos;	//< 旋转角正弦与余弦的和
+	double rref;	//< 旋转角范围的参考角, 即首个数据点的旋转角, 量纲: 角度
+	double rmin, rmax;	//< 旋转角相对参考角的最小值, 最大值, 范围[-180, 180), 量纲: 角度
+	double tmean, tm2, tmin, tmax;	//< 倾斜角的均值, 离差平方和(Welford), 最小值, 最大值
+	QuantileSketch rsketch;	//< 旋转角相对参考角偏差的分位数概要
+	QuantileSketch tsketch;	//< 倾斜角的分位数概要
+
+public:
+	CrossStat() {
+		Reset();
+	}
+
+	/*!
+	 * @brief 清除统计
+	 */
+	void Reset() {
+		n = 0;
+		rsin = rcos = rref = tmean = tm2 = 0.0;
+		rmin = tmin = 1E30;
+		rmax = tmax = -1E30;
+		rsketch.Reset();
+		tsketch.Reset();
+	}
+
+	/*!
+	 * @brief 计算旋转角相对参考角的偏差
+	 * @param r    旋转角, 量纲: 角度
+	 * @param rref 参考角, 量纲: 角度
+	 * @return
+	 * 偏差, 范围[-180, 180), 量纲: 角度
+	 */
+	static double Deviate(double r, double rref) {
+		double d = r - rref;
+		return d - floor((d + 180.0) / 360.0) * 360.0;
+	}
+
+	/*!
+	 * @brief 累加数据点
+	 * @param r 旋转角, 量纲: 角度
+	 * @param t 倾斜角, 量纲: 角度
+	 * @note
+	 * 旋转角按圆周统计累加正弦与余弦, 与数据点顺序无关
+	 */
+	void Add(double r, double t) {
+		double rad = r * D2R, d;
+		if (!n) rref = r;
+		++n;
+		rsin += sin(rad);
+		rcos += cos(rad);
+
+		d = Deviate(r, rref);
+		rsketch.Add(d);
+		if (rmin > d) rmin = d;
+		if (rmax < d) rmax = d;
+		if (tmin > t) tmin = t;
+		if (tmax < t) tmax = t;
+		tsketch.Add(t);
+
+		d = t - tmean;
+		tmean += d / n;
+		tm2 += d * (t - tmean);
+	}
+
+	/*!
+	 * @brief 合并另一组统计
+	 * @param other 另一组统计
+	 * @note
+	 * 合并结果与数据点顺序及分组无关. 旋转角范围假定全部数据点分布在
+	 * 半个圆周之内
+	 */
+	void Merge(const CrossStat& other);
+	/*!
+	 * @brief 旋转角的平均合成矢量长度
+	 * @return
+	 * 范围[0, 1]. 1表示全部旋转角相同, 接近0表示旋转角分散在整个圆周
+	 */
+	double Resultant() const;
+	/*!
+	 * @brief 计算均值与标准差
+	 * @param rmean 旋转角圆周均值, 范围[0, 360), 量纲: 角度
+	 * @param rrms  旋转角圆周标准差, 即sqrt(-2ln(R)), R为平均合成矢量长度, 量纲: 角度
+	 * @param tmean 倾斜角均值, 量纲: 角度
+	 * @param trms  倾斜角标准差, 量纲: 角度
+	 */
+	void Summary(double& rmean, double& rrms, double& tmean, double& trms) const;
+	/*!
+	 * @brief 旋转角范围
+	 * @param rmin 最小值, 归算到[0, 360), 量纲: 角度
+	 * @param rmax 最大值, 归算到[0, 360), 量纲: 角度
+	 */
+	void Range(double& rmin, double& rmax) const;
+	/*!
+	 * @brief 估算分位数
+	 * @param q    分位, 范围[0, 1]
+	 * @param rot  旋转角分位数, 范围[0, 360), 量纲: 角度
+	 * @param tilt 倾斜角分位数, 量纲: 角度
+	 * @note
+	 * 由分位数概要估算, 尾部分位数的精度高于中位数附近
+	 */
+	void Quantile(double q, double& rot, double& tilt) const;
+	/*!
+	 * @brief 输出统计结果
+	 * @param fp 文件描述符
+	 */
+	void Output(FILE* fp) const;
+};
+
+/*!
+ * @brief 由JFoV文件数据生成输出文件名
+ * @param ptf JFoV文件数据, 非空
+ * @return
+ * 输出文件名, 格式: G<cam_id>_<hhmm>-<hhmm>.txt
+ * @note
+ * 两个hhmm分别为JFoV的起始和结束时间
+ */
+string ResultPath(const PointFile& ptf);
+/*!
+ * @brief 由相机标志和JFoV时间范围生成输出文件名
+ * @param cid 相机标志
+ * @param t0  JFoV起始时间
+ * @param t1  JFoV结束时间
+ */
+string ResultPath(const string& cid, TimeStamp t0, TimeStamp t1);
+/*!
+ * @brief 计算交叉数据点相对基准的旋转角与倾斜角
+ * @param pt    交叉数据点记录
+ * @param rot0  旋转基准, 量纲: 角度
+ * @param tilt0 倾斜基准, 量纲: 角度
+ * @param rrot  相对旋转基准的旋转角, 范围[-180, 180], 量纲: 角度
+ * @param rtilt 相对倾斜基准的倾斜角, 量纲: 角度
+ */
+void RelativeBase(const CrossRecord& pt, double rot0, double tilt0, double& rrot, double& rtilt);
+/*!
+ * @brief 输出过程信息
+ * @param fp     文件描述符. NULL时不输出
+ * @param format 格式, 同printf
+ */
+void LogPrint(FILE* fp, const char* format, ...) __attribute__((format(printf, 2, 3)));
+/*!
+ * @brief 输出结果表头
+ * @param fp   文件描述符
+ * @param clip 是否输出剔除标志列
+ */
+void OutputHeader(FILE* fp, bool clip = false);
+/*!
+ * @brief 输出一个交叉数据点
+ * @param fp    文件描述符
+ * @param pt    交叉数据点记录
+ * @param rot0  旋转基准, 量纲: 角度
+ * @param tilt0 倾斜基准, 量纲: 角度
+ * @param clip  剔除标志: 1, 被剔除; 0, 保留; <0, 不输出剔除标志列
+ */
+void OutputCross(FILE* fp, const CrossRecord& pt, double rot0, double tilt0, int clip = -1);
+
+class RelPosSession {// JFoV相对FFoV位置计算会话
+public:
+	RelPosSession();
+	virtual ~RelPosSession();
+
+public:
+	/*!
+	 * @brief 设置过程信息的输出位置
+	 * @param fp 文件描述符. NULL时不输出过程信息
+	 */
+	void SetLog(FILE* fp);
+	/*!
+	 * @brief 设置旋转与倾斜基准
+	 * @param rot  旋转基准, 量纲: 角度
+	 * @param tilt 倾斜基准, 量纲: 角度
+	 */
+	void SetBase(double rot, double tilt);
+	/*!
+	 * @brief 设置扫描数据时的最多线程数量
+	 * @param n 线程数量. <=0时取处理器数量
+	 * @note
+	 * 多个数据段由会话的线程池处理. 线程池在首次分段扫描时创建, 此后各次
+	 * 扫描复用, 线程数量改变时重建
+	 */
+	void SetThreads(int n);
+	/*!
+	 * @brief 设置转台拓扑
+	 * @param topo 转台拓扑
+	 * @note
+	 * 未设置时沿用缺省规则: cam_id整数为5倍数对应FFoV, 否则对应JFoV
+	 */
+	void SetTopology(const MountTopology& topo);
+	/*!
+	 * @brief 设置sigma裁剪
+	 * @param nsigma 裁剪阈值, 标准差的倍数. <=0时不裁剪
+	 * @note
+	 * 裁剪时结果中增加剔除标志列, 统计量只包含保留的数据点
+	 */
+	void SetClip(double nsigma);
+	/*!
+	 * @brief 设置匹配策略
+	 * @param policy 匹配策略. 缺省为MATCH_NEAREST
+	 * @note
+	 * MATCH_INTERP: 取JFoV时间前后相邻的两个FFoV数据点, 相隔不超过INTERP_GAP,
+	 * 按时间在球面上线性插值(SLERP)得到参考方向; 无法插值时退回最近数据点匹配
+	 * @note
+	 * 多个数据点匹配时, 结果中FFoV位置为参考方向, FFoV文件名为权重最大的数据点
+	 */
+	void SetPolicy(MatchPolicy policy);
+	/*!
+	 * @brief 解析文件内容
+	 * @param filepath 原始文件路径
+	 * @return
+	 * 文件解析结果. 相机不在转台拓扑中时返回false
+	 * @note
+	 * 由转台拓扑确定视场类型. 拓扑给定JFoV名义基准时, 替代SetBase()设置的基准
+	 */
+	bool ResolveFile(const string& filepath);
+	/*!
+	 * @brief 关联已解析的文件数据
+	 * @param ptf  文件数据
+	 * @param ffov 文件数据是否来自FFoV
+	 * @return
+	 * 文件数据非空时返回true
+	 * @note
+	 * 文件数据可同时被多个会话共享
+	 */
+	bool Attach(const PointFilePtr& ptf, bool ffov);
+	/*!
+	 * @brief 检查JFoV数据是否完备
+	 */
+	bool HasJFoV() const;
+	/*!
+	 * @brief 检查FFoV数据是否完备
+	 */
+	bool HasFFoV() const;
+	/*!
+	 * @brief 检查JFoV和FFoV的时间有效性
+	 * @return
+	 * 时间有效性
+	 * @note
+	 * 有效性判据: JFoV和FFoV时间范围在匹配容差内有交集
+	 * @note
+	 * 时间戳为绝对时间, 数据可跨越UTC日界
+	 */
+	bool TimeCrossCheck() const;
+	/*!
+	 * @brief 从FFoV原始数据中找到与时间最接近的数据点
+	 * @param key JFoV时间
+	 * @return
+	 * 匹配数据点位置
+	 *  -1: 未找到匹配数据
+	 * >=0: 匹配数据位置
+	 * @note
+	 * 匹配条件: 秒数相差不超过10
+	 * @note
+	 * 用于任意时间点的单次查询, 代价为O(log n)
+	 */
+	int FindMatchedData(TimeStamp key) const;
+	/*!
+	 * @brief 从FFoV原始数据中找到与时间最接近的数据点
+	 * @param key  JFoV时间
+	 * @param from 索引游标. 输入: 起始扫描位置; 输出: 最接近索引项位置
+	 * @return
+	 * 匹配数据点位置
+	 *  -1: 未找到匹配数据
+	 * >=0: 匹配数据位置
+	 * @note
+	 * 匹配条件: 秒数相差不超过10
+	 * @note
+	 * 用于按时间顺序的连续查询, key不小于前次调用时的值
+	 */
+	int FindMatchedData(TimeStamp key, int& from) const;
+	/*!
+	 * @brief 扫描原始数据并计算相对位置
+	 * @return
+	 * 匹配数据点数量
+	 */
+	int ScanData();
+	/*!
+	 * @brief 输出处理结果到文件
+	 * @param fp 文件描述符
+	 * @note
+	 * fp==stdout或stderr时, 输出到控制台, 并输出统计结果
+	 */
+	void OutputResult(FILE* fp) const;
+	/*!
+	 * @brief 查看输出文件名
+	 * @note
+	 * 输出文件名格式: G<cam_id>_<hhmm>-<hhmm>.txt
+	 */
+	const string& OutputPath() const;
+	/*!
+	 * @brief 查看JFoV数据
+	 * @note
+	 * 仅在HasJFoV()为true时有效
+	 */
+	const PointFile& JFoV() const;
+	/*!
+	 * @brief 查看FFoV数据
+	 * @note
+	 * 仅在HasFFoV()为true时有效
+	 */
+	const PointFile& FFoV() const;
+	/*!
+	 * @brief 查看计算结果
+	 */
+	const PtCrossV& Results() const;
+	/*!
+	 * @brief 由结果解析完整记录
+	 * @param i   结果位置
+	 * @param rec 完整记录
+	 * @note
+	 * 位置与文件名取自JFoV/FFoV数据. 多个数据点匹配时FFoV位置为参考方向
+	 */
+	void Resolve(int i, CrossRecord& rec) const;
+	/*!
+	 * @brief 查看计算结果的统计量
+	 * @note
+	 * 由ScanData()在生成结果时累加. 启用sigma裁剪时为保留数据点的统计量
+	 */
+	const CrossStat& Stat() const;
+
+protected:
+	struct ScanChunk {// 并行扫描的JFoV数据段. 数组位于会话内存区, 按段内最多匹配数分配
+		int first, last;	//< JFoV时间索引范围[first, last)
+		int nmatch;		//< 匹配数量
+		int* jpos;		//< 匹配的JFoV数据点位置
+		int* kpos;		//< 匹配的FFoV数据点位置. 多个数据点匹配时为权重最大者
+		int* refs;		//< 多个数据点匹配时的FFoV数据点位置, 每个匹配Width个
+		double* weights;	//< 多个数据点匹配时的权重, 每个匹配Width个
+		double* buff;	//< 计算相对位置的临时空间
+		int offset;		//< 结果在pt_cross_中的起始位置
+		CrossStat stat;	//< 数据段内结果的统计量
+	};
+	typedef vector<ScanChunk> ScanChunkV;
+	typedef void (RelPosSession::*ScanFunc)(ScanChunk*);
+
+	/*!
+	 * @brief 按匹配策略在JFoV数据段内查找匹配的FFoV数据点
+	 * @param chunk 数据段
+	 */
+	template <class Policy> void MatchChunk(ScanChunk* chunk);
+	/*!
+	 * @brief 按匹配策略计算数据段内匹配点的相对位置, 写入pt_cross_的对应区间
+	 * @param chunk 数据段
+	 */
+	template <class Policy> void RelateChunk(ScanChunk* chunk);
+	/*!
+	 * @brief 按匹配策略扫描各数据段
+	 * @param chunks 数据段
+	 * @return
+	 * 匹配数量. 无法分配内存时返回-1
+	 */
+	template <class Policy> int ScanWith(ScanChunkV& chunks);
+	/*!
+	 * @brief 对各数据段并行执行处理函数
+	 * @param chunks 数据段
+	 * @param func   处理函数
+	 * @note
+	 * 多个数据段时提交到pool_并等待全部完成
+	 */
+	void RunChunks(ScanChunkV& chunks, ScanFunc func);
+	/*!
+	 * @brief 对结果执行sigma裁剪, 更新剔除标志与统计量
+	 */
+	void Clip();
+
+protected:
+	FILE* log_;			//< 过程信息输出位置
+	double rot0_, tilt0_;	//< 旋转与倾斜基准, 量纲: 角度
+	int nthread_;		//< 扫描数据时的最多线程数量
+	std::unique_ptr<WorkPool> pool_;	//< 并行扫描数据段的线程池
+	double nsigma_;		//< sigma裁剪阈值. <=0时不裁剪
+	MatchPolicy policy_;	//< 匹配策略
+	ArenaArray<char> rejected_;	//< 各结果是否被sigma裁剪剔除
+	int nrejected_;		//< 被剔除的结果数量
+	int niter_;			//< sigma裁剪的迭代次数
+	MountTopology topo_;	//< 转台拓扑
+	CameraTable cameras_;	//< 相机标志驻留表
+	PointFilePtr pt_jfov_, pt_ffov_;	//< JFoV和FFoV的文件数据集合
+	string pathDst_;	//< 输出文件名
+	PtCrossV pt_cross_;	//< 数据交叉结果
+	ArenaArray<double> ref_;	//< 多个数据点匹配时各结果的参考方向(赤经, 赤纬), 量纲: 角度
+	Arena arena_;		//< 结果与扫描临时数组的内存区, 以大页为后备. 每次扫描时清空
+	CrossStat stat_;	//< 数据交叉结果的统计量
+
+private:
+	RelPosSession(const RelPosSession&);
+	RelPosSession& operator=(const RelPosSession&);
+};
+
+#endif /* RELPOS_SESSION_H_ */
@@ -0,0 +1,139 @@
+/*
+ Name        : relpos_sketch.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 分位数概要(合并式t-digest)
+ */
+
+#include <algorithm>
+#include <math.h>
+#include "relpos_math.h"
+#include "relpos_sketch.h"
+
+QuantileSketch::QuantileSketch() {
+	Reset();
+}
+
+void QuantileSketch::Reset() {
+	centroids_.clear();
+	buffer_.clear();
+	buffer_.reserve(SKETCH_BUFFER);
+	count_ = 0.0;
+	xmin_  = 1E30;
+	xmax_  = -1E30;
+}
+
+void QuantileSketch::Add(double x) {
+	Centroid c;
+	c.mean   = x;
+	c.weight = 1.0;
+	buffer_.push_back(c);
+	count_ += 1.0;
+	if (xmin_ > x) xmin_ = x;
+	if (xmax_ < x) xmax_ = x;
+	if (buffer_.size() >= SKETCH_BUFFER) Compress();
+}
+
+/*
+ * 相邻质心合并后的权重不使k(q)跨越超过1
+ */
+void QuantileSketch::Compress(const CentroidV& items, double total, CentroidV& out) {
+	int n = items.size(), i;
+	double kscale = SKETCH_DELTA / PI360;
+	double wsofar(0.0), limit;
+	Centroid cur;
+
+	out.clear();
+	if (!n) return;
+	limit = total * (sin((asin(-1.0) * kscale + 1.0) / kscale) + 1.0) * 0.5;
+	cur = items[0];
+	for (i = 1; i < n; ++i) {
+		const Centroid& x = items[i];
+		if (wsofar + cur.weight + x.weight <= limit) {
+			cur.weight += x.weight;
+			cur.mean += (x.mean - cur.mean) * x.weight / cur.weight;
+		}
+		else {
+			wsofar += cur.weight;
+			out.push_back(cur);
+			double k = asin(2.0 * wsofar / total - 1.0) * kscale + 1.0;
+			limit = k >= SKETCH_DELTA * 0.25 ? total : total * (sin(k / kscale) + 1.0) * 0.5;
+			cur = x;
+		}
+	}
+	out.push_back(cur);
+}
+
+/*
+ * 临时集合与质心集合的容量在各次压缩间复用, 稳定后不再分配内存
+ */
+void QuantileSketch::Compress() {
+	if (buffer_.empty()) return;
+
+	work_.assign(centroids_.begin(), centroids_.end());
+	work_.insert(work_.end(), buffer_.begin(), buffer_.end());
+	std::sort(work_.begin(), work_.end());
+	Compress(work_, count_, centroids_);
+	buffer_.clear();
+}
+
+/*
+ * other的质心作为带权数据点进入缓存, 不立即压缩. 连续合并多组概要时全部
+ * 质心只压缩一次, 避免逐组压缩累积的误差
+ */
+void QuantileSketch::Merge(const QuantileSketch& other, double shift) {
+	if (other.count_ <= 0.0) return;
+
+	int n = other.centroids_.size(), m = other.buffer_.size(), i;
+	buffer_.reserve(buffer_.size() + n + m);
+	for (i = 0; i < n; ++i) {
+		buffer_.push_back(other.centroids_[i]);
+		buffer_.back().mean += shift;
+	}
+	for (i = 0; i < m; ++i) {
+		buffer_.push_back(other.buffer_[i]);
+		buffer_.back().mean += shift;
+	}
+	count_ += other.count_;
+	if (xmin_ > other.xmin_ + shift) xmin_ = other.xmin_ + shift;
+	if (xmax_ < other.xmax_ + shift) xmax_ = other.xmax_ + shift;
+	if (buffer_.size() >= SKETCH_MERGE) Compress();
+}
+
+/*
+ * 质心均值视为位于其权重中点处的分位. 缓存非空时与质心一起压缩到临时集合再
+ * 插值: 合并得到的各组质心相互交叠, 直接插值的误差远大于压缩后
+ */
+double QuantileSketch::Quantile(double q) const {
+	if (count_ <= 0.0) return 0.0;
+
+	CentroidV items;
+	if (buffer_.empty()) items = centroids_;
+	else {
+		CentroidV all(centroids_);
+		all.insert(all.end(), buffer_.begin(), buffer_.end());
+		std::sort(all.begin(), all.end());
+		Compress(all, count_, items);
+	}
+
+	int n = items.size(), i;
+	double index = q * count_, wsofar, dw;
+	if (n == 1 || index <= 0.0) return n == 1 ? items[0].mean : xmin_;
+	if (index >= count_) return xmax_;
+
+	wsofar = items[0].weight * 0.5;
+	if (index < wsofar) return xmin_ + (items[0].mean - xmin_) * index / wsofar;
+	for (i = 0; i < n - 1; ++i, wsofar += dw) {
+		dw = (items[i].weight + items[i + 1].weight) * 0.5;
+		if (wsofar + dw > index) {
+			double z = (index - wsofar) / dw;
+			return items[i].mean + (items[i + 1].mean - items[i].mean) * z;
+		}
+	}
+	dw = items[n - 1].weight * 0.5;
+	return items[n - 1].mean + (xmax_ - items[n - 1].mean) * (index - wsofar) / dw;
+}
+
+double QuantileSketch::Count() const {
+	return count_;
+}
@@ -0,0 +1,93 @@
+/*
+ Name        : relpos_sketch.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 分位数概要(合并式t-digest)
+ 数据点先进入缓存, 缓存满时与已有质心按均值排序后贪心合并. 质心容许的
+ 权重由尺度函数k(q) = δ/(2π)·asin(2q-1)约束, 分位两端的质心很小, 因此
+ 1%/99%等尾部分位数的精度高于中位数附近. 质心数量不超过δ, 内存固定
+ */
+
+#ifndef RELPOS_SKETCH_H_
+#define RELPOS_SKETCH_H_
+
+#include <vector>
+
+using std::vector;
+
+//////////////////////////////////////////////////////////////////////////////
+/// 宏定义
+#define SKETCH_DELTA	200		// 压缩参数δ
+#define SKETCH_BUFFER	1000	// 数据点缓存容量
+#define SKETCH_MERGE	16384	// 合并时缓存的最大容量
+
+class QuantileSketch {// 可合并的分位数概要
+public:
+	QuantileSketch();
+
+public:
+	/*!
+	 * @brief 清除数据
+	 */
+	void Reset();
+	/*!
+	 * @brief 累加数据点
+	 * @param x 数据
+	 */
+	void Add(double x);
+	/*!
+	 * @brief 合并另一组概要
+	 * @param other 另一组概要
+	 * @param shift other中数据的平移量
+	 * @note
+	 * 质心在缓存中累积至SKETCH_MERGE后才压缩. 连续合并多组概要时全部质心
+	 * 一起压缩一次, 合并结果的精度与单组概要相当
+	 */
+	void Merge(const QuantileSketch& other, double shift = 0.0);
+	/*!
+	 * @brief 估算分位数
+	 * @param q 分位, 范围[0, 1]
+	 * @return
+	 * 分位数. 无数据时返回0
+	 * @note
+	 * 在相邻质心间线性插值, 两端以最小值和最大值为界
+	 */
+	double Quantile(double q) const;
+	/*!
+	 * @brief 累加的数据点数量
+	 */
+	double Count() const;
+
+protected:
+	struct Centroid {// 质心
+		double mean;	//< 均值
+		double weight;	//< 权重, 即代表的数据点数量
+
+	public:
+		bool operator<(const Centroid& other) const {
+			return mean < other.mean;
+		}
+	};
+	typedef vector<Centroid> CentroidV;
+
+	/*!
+	 * @brief 缓存与质心合并为新的质心集合
+	 */
+	void Compress();
+	/*!
+	 * @brief 由已排序的质心集合贪心合并
+	 * @param items 按均值排序的质心
+	 * @param total 总权重
+	 * @param out   合并后的质心
+	 */
+	static void Compress(const CentroidV& items, double total, CentroidV& out);
+
+protected:
+	CentroidV centroids_;	//< 质心, 按均值排序
+	CentroidV buffer_;		//< 尚未合并的数据点
+	CentroidV work_;		//< 压缩时的临时质心集合, 容量复用
+	double count_;		//< 累加的数据点数量
+	double xmin_, xmax_;	//< 最小值与最大值
+};
+
+#endif /* RELPOS_SKETCH_H_ */
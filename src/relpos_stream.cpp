@@ -0,0 +1,329 @@
+/*
+ Name        : relpos_stream.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 流式JFoV相对FFoV位置计算
+ */
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "relpos_stream.h"
+
+RelPosStream::RelPosStream() {
+	log_    = stderr;
+	out_    = stdout;
+	rot0_   = 0.0;
+	tilt0_  = 0.0;
+	window_ = STREAM_WINDOW;
+	matched_= 0;
+	starved_= 0;
+	tfeed_  = 0;
+	header_ = false;
+}
+
+RelPosStream::~RelPosStream() {
+	mounts_.clear();
+	slots_.clear();
+}
+
+void RelPosStream::SetLog(FILE* fp) {
+	log_ = fp;
+}
+
+void RelPosStream::SetOutput(FILE* fp) {
+	out_ = fp;
+}
+
+void RelPosStream::SetBase(double rot, double tilt) {
+	rot0_  = rot;
+	tilt0_ = tilt;
+}
+
+void RelPosStream::SetTopology(const MountTopology& topo) {
+	topo_ = topo;
+}
+
+void RelPosStream::SetWindow(int window) {
+	window_ = window < 2 * MATCH_TOL ? 2 * MATCH_TOL : window;
+}
+
+/*
+ * 相机句柄由驻留表顺序分配, 新句柄总是等于已登记数量
+ */
+RelPosStream::CameraSlot& RelPosStream::Slot(int cam) {
+	if (cam >= (int) slots_.size()) {
+		CameraSlot slot;
+		slot.known = topo_.Classify(cameras_.Name(cam), slot.role);
+		slot.mount = slot.known ? &mounts_[slot.role.mount] : NULL;
+		slot.first = slot.last = 0;
+		if (slot.known && !slot.role.ffov) slot.mount->jcams.push_back(cam);
+		if (!slot.known) LogPrint(log_, "camera<%s> is not found in topology\n", cameras_.Name(cam).c_str());
+		else {
+			LogPrint(log_, "camera<%s> is considered to be %s on mount %s\n", cameras_.Name(cam).c_str(),
+					slot.role.ffov ? "FFoV" : "JFoV", slot.role.mount.c_str());
+		}
+		slots_.push_back(slot);
+	}
+	return slots_[cam];
+}
+
+bool RelPosStream::Feed(const char* line, const char* end) {
+	double ra, dc;
+	TextSpan fname;
+	TimeStamp t;
+	int cam;
+
+	if (!ResolveLine(line, end, ra, dc, fname, stat_)) return false;
+	if (!ResolveFilename(fname, cameras_, cam, t)) {
+		++stat_.fname;
+		return false;
+	}
+	return FeedPoint(cam, t, ra, dc, fname);
+}
+
+bool RelPosStream::FeedRecord(const char* cid, int len, TimeStamp t, double ra, double dc) {
+	return FeedPoint(cameras_.Intern(cid, len), t, ra, dc, TextSpan());
+}
+
+/*
+ * 偶有乱序的FFoV记录按时间插入历史, 其后的JFoV仍可与之匹配
+ */
+bool RelPosStream::FeedPoint(int cam, TimeStamp t, double ra, double dc, const TextSpan& fname) {
+	CameraSlot& slot = Slot(cam);
+	if (!slot.known) return false;
+
+	MountStream& ms = *slot.mount;
+	tfeed_ = t;
+	StreamPointQ& queue = slot.role.ffov ? ms.ffov : ms.jfov;
+	StreamPointQ::iterator it = queue.end();
+	if (slot.role.ffov) {
+		for (; it != queue.begin() && (it - 1)->t > t; --it);
+	}
+	else {
+		if (queue.empty() || t > ms.tjfov) ms.tjfov = t;
+		if (!slot.first || t < slot.first) slot.first = t;
+		if (t > slot.last) slot.last = t;
+	}
+	it = queue.insert(it, StreamPoint());
+	it->t   = t;
+	it->ra  = ra;
+	it->dc  = dc;
+	it->cam = cam;
+	it->gen = ms.gen;
+	it->fname = ms.names[ms.gen].Copy(fname.ptr, fname.len);
+	++ms.live[ms.gen];
+	if (slot.role.ffov) it->rmat.Set(ra * D2R, dc * D2R);
+
+	Settle(ms, false);
+	Prune(ms);
+	return true;
+}
+
+int RelPosStream::FeedChunk(string& buff, const char* chunk, int len) {
+	size_t first(0), last;
+	int n(0);
+	buff.append(chunk, len);
+	while ((last = buff.find('\n', first)) != string::npos) {
+		if (Feed(buff.data() + first, buff.data() + last)) ++n;
+		first = last + 1;
+	}
+	buff.erase(0, first);
+	return n;
+}
+
+void RelPosStream::Flush() {
+	for (MountStreamMap::iterator it = mounts_.begin(); it != mounts_.end(); ++it) {
+		Settle(it->second, true);
+	}
+	fflush(out_);
+}
+
+const RelPosStream::StreamPoint* RelPosStream::Nearest(const StreamPointQ& ffov, TimeStamp key) const {
+	int n = ffov.size(), i;
+	if (!n) return NULL;
+
+	i = std::lower_bound(ffov.begin(), ffov.end(), key,
+			[](const StreamPoint& pt, TimeStamp t) { return pt.t < t; }) - ffov.begin();
+	if (i == n || (i > 0 && key - ffov[i - 1].t < ffov[i].t - key)) --i;
+	else for (; i + 1 < n && ffov[i + 1].t == ffov[i].t; ++i);
+
+	return (llabs(ffov[i].t - key) > MATCH_TOL ? NULL : &ffov[i]);
+}
+
+/*
+ * JFoV按到达顺序输出. FFoV历史中最新时间超出JFoV时间的匹配容差后, 后续FFoV
+ * 不会更接近该JFoV, 匹配结果已确定
+ */
+void RelPosStream::Settle(MountStream& ms, bool all) {
+	while (!ms.jfov.empty()) {
+		const StreamPoint& jp = ms.jfov.front();
+		if (!all) {
+			bool settled = (!ms.ffov.empty() && ms.ffov.back().t > jp.t + MATCH_TOL)
+					|| jp.t < ms.tjfov - window_;
+			if (!settled) break;
+		}
+
+		const StreamPoint* fp = Nearest(ms.ffov, jp.t);
+		if (fp) {
+			const CameraRole& role = slots_[jp.cam].role;
+			CrossRecord ptc;
+			ptc.ra     = jp.ra;
+			ptc.dc     = jp.dc;
+			ptc.fname  = jp.fname;
+			ptc.ra0    = fp->ra;
+			ptc.dc0    = fp->dc;
+			ptc.fname0 = fp->fname;
+			ptc.Relate(fp->rmat);
+
+			Emit(jp, ptc, role.based ? role.rot0 : rot0_, role.based ? role.tilt0 : tilt0_);
+			++matched_;
+		}
+		else if (ms.ffov.empty() || ms.ffov.back().t < jp.t - MATCH_TOL) ++starved_;
+		PopFront(ms, ms.jfov);
+	}
+}
+
+/*
+ * 首个结果前输出表头
+ */
+void RelPosStream::Emit(const StreamPoint&, const CrossRecord& ptc, double rot0, double tilt0) {
+	if (!header_) {
+		OutputHeader(out_);
+		header_ = true;
+	}
+	OutputCross(out_, ptc, rot0, tilt0);
+}
+
+/*
+ * 仍需FFoV的最早时间取以下各项的最小值:
+ * 1) 等待中的JFoV. 队列只按相机各自有序, 头部未必最早
+ * 2) 各JFoV相机的最新记录, 其后续记录不会更早
+ * 3) 最新JFoV时间之前一个窗口, 尚未出现的JFoV相机按到达约束不会更早
+ * 早于该时间超过匹配容差的FFoV不会再被用到. 尚无JFoV记录时只按窗口丢弃
+ */
+void RelPosStream::Prune(MountStream& ms) {
+	if (ms.ffov.empty()) return;
+
+	TimeStamp from = ms.ffov.back().t - window_;
+	int n = ms.jcams.size(), i;
+	if (n) {
+		TimeStamp need = ms.tjfov - window_;
+		for (StreamPointQ::const_iterator it = ms.jfov.begin(); it != ms.jfov.end(); ++it) {
+			if (it->t < need) need = it->t;
+		}
+		for (i = 0; i < n; ++i) {
+			if (slots_[ms.jcams[i]].last < need) need = slots_[ms.jcams[i]].last;
+		}
+		if (need - MATCH_TOL > from) from = need - MATCH_TOL;
+	}
+	while (!ms.ffov.empty() && ms.ffov.front().t < from) PopFront(ms, ms.ffov);
+}
+
+void RelPosStream::PopFront(MountStream& ms, StreamPointQ& queue) {
+	--ms.live[queue.front().gen];
+	queue.pop_front();
+	if (ms.names[ms.gen].Used() >= STREAM_NAMES && !ms.live[1 - ms.gen]) {
+		ms.gen = 1 - ms.gen;
+		ms.names[ms.gen].Reset();
+	}
+}
+
+/*
+ * 领先的输入留出两倍匹配容差的余量: 落后输入的记录到达后, 领先输入中被窗口
+ * 强制确定的JFoV已有其匹配容差内的全部FFoV, 领先的FFoV也未被窗口丢弃.
+ * 其它输入尚无记录时无从比较, 已有记录的输入先等待
+ */
+bool RelPosStream::Leading(const StreamInputV& inputs, int i) const {
+	TimeStamp last = inputs[i].last;
+	if (!last) return false;
+	for (int j = 0; j < (int) inputs.size(); ++j) {
+		if (j == i || inputs[j].fd < 0) continue;
+		if (!inputs[j].last || last - inputs[j].last > window_ - 2 * MATCH_TOL) return true;
+	}
+	return false;
+}
+
+/*
+ * 逐行检查是否领先, 一次读取的大段数据不会越过其它输入
+ */
+int RelPosStream::Drain(StreamInputV& inputs, int i) {
+	StreamInput& input = inputs[i];
+	size_t first(0), last;
+	int n(0);
+	while (!Leading(inputs, i) && (last = input.buff.find('\n', first)) != string::npos) {
+		if (Feed(input.buff.data() + first, input.buff.data() + last) && tfeed_ > input.last) input.last = tfeed_;
+		first = last + 1;
+		++n;
+	}
+	input.buff.erase(0, first);
+	return n;
+}
+
+/*
+ * FIFO在写入端打开前阻塞. 行跨越两次读取时暂存于输入缓存. 领先的输入不参与
+ * 等待, 其写入端在管道写满后阻塞
+ */
+bool RelPosStream::Run(const vector<string>& paths) {
+	int n = paths.size(), nopen(0), i;
+	vector<struct pollfd> fds(n);
+	StreamInputV inputs(n);
+	char chunk[65536];
+	bool progress;
+
+	for (i = 0; i < n; ++i) {
+		inputs[i].fd = paths[i] == "-" ? STDIN_FILENO : open(paths[i].c_str(), O_RDONLY);
+		inputs[i].last = 0;
+		fds[i].events = POLLIN;
+		if (inputs[i].fd < 0) {
+			LogPrint(log_, "fail to open input<%s>\n", paths[i].c_str());
+			for (--i; i >= 0; --i) {
+				if (inputs[i].fd != STDIN_FILENO) close(inputs[i].fd);
+			}
+			return false;
+		}
+		++nopen;
+	}
+
+	while (nopen) {
+		// 一个输入推进后, 暂停的输入可能恢复
+		do {
+			progress = false;
+			for (i = 0; i < n; ++i) {
+				if (inputs[i].fd >= 0 && Drain(inputs, i)) progress = true;
+			}
+		} while (progress);
+		fflush(out_);
+
+		for (i = 0; i < n; ++i) fds[i].fd = Leading(inputs, i) ? -1 : inputs[i].fd;
+		if (poll(&fds[0], n, -1) < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+
+		for (i = 0; i < n; ++i) {
+			if (fds[i].fd < 0 || !fds[i].revents) continue;
+
+			StreamInput& input = inputs[i];
+			ssize_t len = read(input.fd, chunk, sizeof(chunk));
+			if (len < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+			if (len > 0) input.buff.append(chunk, len);
+			else {// 输入结束. 未领先的输入已处理全部完整行, 缓存中至多余下不完整的行
+				if (!input.buff.empty()) Feed(input.buff.data(), input.buff.data() + input.buff.size());
+				input.buff.clear();
+				if (input.fd != STDIN_FILENO) close(input.fd);
+				input.fd = -1;
+				--nopen;
+			}
+		}
+	}
+
+	for (i = 0; i < n; ++i) {
+		if (inputs[i].fd >= 0 && inputs[i].fd != STDIN_FILENO) close(inputs[i].fd);
+	}
+	Flush();
+	return true;
+}
@@ -0,0 +1,260 @@
+/*
+ Name        : relpos_stream.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 流式JFoV相对FFoV位置计算
+ 逐行接收交织的JFoV/FFoV记录, 每个转台只保留有限时间窗口内的FFoV历史.
+ 当FFoV记录时间超出JFoV时间的匹配容差后, 该JFoV的最近FFoV已经确定,
+ 立即输出其交叉数据点.
+ 约束: 同一相机的记录按时间顺序到达, JFoV与FFoV的到达时间差不超过历史窗口
+ */
+
+#ifndef RELPOS_STREAM_H_
+#define RELPOS_STREAM_H_
+
+#include <deque>
+#include <map>
+#include <stdio.h>
+#include "relpos_session.h"
+#include "relpos_arena.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/// 宏定义
+#define STREAM_WINDOW	60000	// 历史窗口的缺省长度, 量纲: 0.01秒
+#define STREAM_NAMES	ARENA_BLOCK	// 文件名区切换代的长度, 量纲: 字节
+
+class RelPosStream {// 流式JFoV相对FFoV位置计算
+public:
+	RelPosStream();
+	virtual ~RelPosStream();
+
+public:
+	/*!
+	 * @brief 设置过程信息的输出位置
+	 * @param fp 文件描述符. NULL时不输出过程信息
+	 */
+	void SetLog(FILE* fp);
+	/*!
+	 * @brief 设置结果的输出位置
+	 * @param fp 文件描述符
+	 */
+	void SetOutput(FILE* fp);
+	/*!
+	 * @brief 设置旋转与倾斜基准
+	 * @param rot  旋转基准, 量纲: 角度
+	 * @param tilt 倾斜基准, 量纲: 角度
+	 * @note
+	 * 转台拓扑给定名义基准的JFoV使用其名义基准
+	 */
+	void SetBase(double rot, double tilt);
+	/*!
+	 * @brief 设置转台拓扑
+	 * @param topo 转台拓扑
+	 */
+	void SetTopology(const MountTopology& topo);
+	/*!
+	 * @brief 设置FFoV历史窗口
+	 * @param window 窗口长度, 量纲: 0.01秒. 不小于匹配容差的2倍
+	 * @note
+	 * 早于最新FFoV时间超过窗口长度的FFoV记录被丢弃; 早于最新JFoV时间超过
+	 * 窗口长度的JFoV记录不再等待后续FFoV, 按已有数据确定匹配. FFoV历史至少
+	 * 覆盖最新JFoV时间之前的一个窗口, 供尚未出现的JFoV相机使用
+	 */
+	void SetWindow(int window);
+	/*!
+	 * @brief 处理一行记录
+	 * @param line 行起始位置
+	 * @param end  行结束位置
+	 * @return
+	 * 记录有效且相机在转台拓扑中时返回true
+	 * @note
+	 * 已确定匹配的JFoV记录立即输出
+	 */
+	bool Feed(const char* line, const char* end);
+	/*!
+	 * @brief 处理一条已解析的记录
+	 * @param cid 相机标志
+	 * @param len 相机标志长度
+	 * @param t   时间
+	 * @param ra  赤经, 量纲: 角度
+	 * @param dc  赤纬, 量纲: 角度
+	 * @return
+	 * 相机在转台拓扑中时返回true
+	 * @note
+	 * 记录没有文件名, 结果中的文件名为空
+	 */
+	bool FeedRecord(const char* cid, int len, TimeStamp t, double ra, double dc);
+	/*!
+	 * @brief 处理一段输入数据
+	 * @param buff  不完整行的缓存
+	 * @param chunk 输入数据
+	 * @param len   数据长度
+	 * @return
+	 * 被接受的记录数量
+	 * @note
+	 * 完整行立即处理, 末尾不完整的行暂存于buff, 与后续数据拼接
+	 */
+	int FeedChunk(string& buff, const char* chunk, int len);
+	/*!
+	 * @brief 输入结束, 确定并输出全部等待中的JFoV记录
+	 */
+	void Flush();
+	/*!
+	 * @brief 从文件, 管道或FIFO读取记录直至全部输入结束
+	 * @param paths 输入路径. "-"对应标准输入
+	 * @return
+	 * 全部输入可以打开时返回true
+	 * @note
+	 * 多个输入同时等待, 任一输入有数据即处理. 某一输入的记录时间领先其它输入
+	 * 接近历史窗口时暂停读取该输入, 直至其它输入赶上或结束
+	 */
+	bool Run(const vector<string>& paths);
+	/*!
+	 * @brief 已输出的匹配数据点数量
+	 */
+	int Matched() const {
+		return matched_;
+	}
+	/*!
+	 * @brief 确定匹配时没有可用FFoV历史的JFoV记录数量
+	 * @note
+	 * FFoV历史为空或全部早于JFoV时间超过匹配容差. 这些记录因超出窗口或输入
+	 * 结束而被确定, 没有输出结果
+	 */
+	int Starved() const {
+		return starved_;
+	}
+	/*!
+	 * @brief 记录解析统计
+	 */
+	const ResolveStat& Stat() const {
+		return stat_;
+	}
+
+protected:
+	struct StreamPoint {// 流中的数据点
+		TimeStamp t;		//< 时间
+		double ra, dc;		//< 中心位置, 量纲: 角度
+		TextSpan fname;		//< 文件名, 位于所属转台的文件名区
+		int cam;			//< 相机标志句柄
+		int gen;			//< 文件名所在的代
+		RotateMatrix rmat;	//< 以FFoV数据点为极轴的旋转矩阵. 仅用于FFoV
+	};
+	typedef std::deque<StreamPoint> StreamPointQ;
+
+	struct MountStream {// 转台的流状态
+		StreamPointQ ffov;	//< FFoV历史, 按时间升序排列
+		StreamPointQ jfov;	//< 等待匹配的JFoV, 按到达顺序排列
+		TimeStamp tjfov;	//< 最新JFoV时间
+		vector<int> jcams;	//< 转台中已出现的JFoV相机句柄
+		Arena names[2];		//< 两代文件名区, 新记录的文件名复制到当前代
+		int live[2];		//< 各代中仍在队列里的记录数量
+		int gen;			//< 当前代
+
+	public:
+		MountStream() : tjfov(0), gen(0) {
+			live[0] = live[1] = 0;
+		}
+	};
+	typedef std::map<string, MountStream> MountStreamMap;
+
+	struct CameraSlot {// 相机句柄对应的角色
+		CameraRole role;	//< 相机角色
+		bool known;			//< 相机是否在转台拓扑中
+		MountStream* mount;	//< 所属转台的流状态
+		TimeStamp first;	//< 相机最早记录时间
+		TimeStamp last;		//< 相机最新记录时间
+	};
+	typedef vector<CameraSlot> CameraSlotV;
+
+	struct StreamInput {// 输入的读取状态
+		int fd;			//< 文件描述符. 输入结束后为-1
+		string buff;	//< 已读取但尚未处理的数据
+		TimeStamp last;	//< 已接受记录的最新时间
+	};
+	typedef vector<StreamInput> StreamInputV;
+
+	/*!
+	 * @brief 查找相机句柄对应的角色, 首次出现时登记
+	 */
+	CameraSlot& Slot(int cam);
+	/*!
+	 * @brief 将数据点加入所属转台的流状态, 并输出已确定匹配的JFoV记录
+	 * @return
+	 * 相机在转台拓扑中时返回true
+	 */
+	bool FeedPoint(int cam, TimeStamp t, double ra, double dc, const TextSpan& fname);
+	/*!
+	 * @brief 确定并输出转台中已可确定匹配的JFoV记录
+	 * @param ms  转台流状态
+	 * @param all 是否确定全部JFoV记录
+	 */
+	void Settle(MountStream& ms, bool all);
+	/*!
+	 * @brief 丢弃不再需要的FFoV历史
+	 */
+	void Prune(MountStream& ms);
+	/*!
+	 * @brief 从队列头部移除记录
+	 * @note
+	 * 当前代写满且上一代已无记录时, 清空上一代并切换为当前代. 队列大致按
+	 * 到达顺序移除, 稳定运行时文件名区不再映射新内存
+	 */
+	void PopFront(MountStream& ms, StreamPointQ& queue);
+	/*!
+	 * @brief 检查输入是否领先其它未结束的输入
+	 * @param inputs 全部输入
+	 * @param i      输入序号
+	 * @return
+	 * 该输入的记录时间领先任一其它输入超过窗口减去两倍匹配容差, 或其它输入
+	 * 尚无记录时返回true
+	 */
+	bool Leading(const StreamInputV& inputs, int i) const;
+	/*!
+	 * @brief 处理输入缓存中的完整行, 直至该输入领先其它输入
+	 * @param inputs 全部输入
+	 * @param i      输入序号
+	 * @return
+	 * 处理的行数
+	 */
+	int Drain(StreamInputV& inputs, int i);
+	/*!
+	 * @brief 在FFoV历史中查找与时间最接近的数据点
+	 * @return
+	 * 匹配数据点. 未找到时返回NULL
+	 * @note
+	 * 时间差相同时取后一个数据点, 与TimeIndex::Nearest一致
+	 */
+	const StreamPoint* Nearest(const StreamPointQ& ffov, TimeStamp key) const;
+	/*!
+	 * @brief 输出已确定匹配的交叉数据点
+	 * @param jp    JFoV数据点
+	 * @param ptc   交叉数据点
+	 * @param rot0  旋转基准, 量纲: 角度
+	 * @param tilt0 倾斜基准, 量纲: 角度
+	 * @note
+	 * 缺省输出到SetOutput()设置的位置. 派生类可改变输出方式
+	 */
+	virtual void Emit(const StreamPoint& jp, const CrossRecord& ptc, double rot0, double tilt0);
+
+protected:
+	FILE* log_;			//< 过程信息输出位置
+	FILE* out_;			//< 结果输出位置
+	double rot0_, tilt0_;	//< 旋转与倾斜基准, 量纲: 角度
+	int window_;		//< FFoV历史窗口, 量纲: 0.01秒
+	MountTopology topo_;	//< 转台拓扑
+	CameraTable cameras_;	//< 相机标志驻留表
+	CameraSlotV slots_;		//< 相机句柄对应的角色
+	MountStreamMap mounts_;	//< 各转台的流状态
+	ResolveStat stat_;	//< 记录解析统计
+	int matched_;		//< 已输出的匹配数据点数量
+	int starved_;		//< 没有可用FFoV历史的JFoV记录数量
+	TimeStamp tfeed_;	//< 最近接受记录的时间
+	bool header_;		//< 是否已输出表头
+
+private:
+	RelPosStream(const RelPosStream&);
+	RelPosStream& operator=(const RelPosStream&);
+};
+
+#endif /* RELPOS_STREAM_H_ */
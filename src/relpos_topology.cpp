@@ -0,0 +1,85 @@
+/*
+ Name        : relpos_topology.cpp
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 转台拓扑: 相机所属转台, 视场类型及名义基准
+ */
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "relpos_topology.h"
+
+static bool RoleLess(const CameraRole& x, const CameraRole& y) {
+	return x.cid < y.cid;
+}
+
+/*
+ * 同一相机出现多次时以最后一次为准
+ */
+bool MountTopology::Load(const string& filepath) {
+	const char seps[] = " \t\r\n";
+	FILE* fp = fopen(filepath.c_str(), "r");
+	char line[1024];
+	int nline(0);
+
+	roles_.clear();
+	errors_.clear();
+	if (!fp) return false;
+	while (fgets(line, sizeof(line), fp)) {
+		const char* ptr = line;
+		const char* end = line + strlen(line);
+		TextSpan cid, mount, role, rot, tilt;
+		CameraRole entry;
+
+		++nline;
+		if (!(cid = NextToken(ptr, end, seps)).len || *cid.ptr == '#') continue;
+		mount = NextToken(ptr, end, seps);
+		role  = NextToken(ptr, end, seps);
+		rot   = NextToken(ptr, end, seps);
+		tilt  = NextToken(ptr, end, seps);
+		if (role.len != 4
+				|| (strncasecmp(role.ptr, "FFoV", 4) && strncasecmp(role.ptr, "JFoV", 4))
+				|| (rot.len && !(tilt.len && SpanToDouble(rot, entry.rot0) && SpanToDouble(tilt, entry.tilt0)))) {
+			errors_.push_back(nline);
+			continue;
+		}
+
+		entry.cid   = string(cid.ptr, cid.len);
+		entry.mount = string(mount.ptr, mount.len);
+		entry.ffov  = !strncasecmp(role.ptr, "FFoV", 4);
+		entry.based = rot.len > 0;
+		roles_.push_back(entry);
+	}
+	fclose(fp);
+
+	std::stable_sort(roles_.begin(), roles_.end(), RoleLess);
+	CameraRoleV::iterator it = roles_.begin();
+	for (CameraRoleV::iterator next = it; next != roles_.end(); ++next) {
+		if (next + 1 == roles_.end() || next[1].cid != next->cid) *it++ = *next;
+	}
+	roles_.erase(it, roles_.end());
+
+	return errors_.empty();
+}
+
+bool MountTopology::Classify(const string& cid, CameraRole& role) const {
+	if (roles_.empty()) {
+		char buff[20];
+		int id = atoi(cid.c_str());
+		sprintf(buff, "%02d", id / 10);
+		role = CameraRole();
+		role.cid   = cid;
+		role.mount = buff;
+		role.ffov  = id % 5 == 0;
+		return true;
+	}
+
+	CameraRole key;
+	key.cid = cid;
+	CameraRoleV::const_iterator it = std::lower_bound(roles_.begin(), roles_.end(), key, RoleLess);
+	if (it == roles_.end() || it->cid != cid) return false;
+	role = *it;
+	return true;
+}
@@ -0,0 +1,75 @@
+/*
+ Name        : relpos_topology.h
+ Author      : Xiaomeng Lu
+ Copyright   : SVOM Group, NAOC
+ Description : 转台拓扑: 相机所属转台, 视场类型及名义基准
+ 配置文件每行描述一台相机, 字段以空格或制表符分隔:
+   <cam_id> <mount> <role> [rot0 tilt0]
+   cam_id: 相机标志
+   mount : 转台名称
+   role  : JFoV或FFoV, 不区分大小写
+   rot0  : 名义旋转基准, 量纲: 角度. 仅对JFoV有效, 缺省时使用命令行基准
+   tilt0 : 名义倾斜基准, 量纲: 角度
+ 空行和以#开始的行被忽略
+ */
+
+#ifndef RELPOS_TOPOLOGY_H_
+#define RELPOS_TOPOLOGY_H_
+
+#include "relpos_point.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/// 数据结构
+struct CameraRole {// 相机在转台中的角色
+	string cid;		//< 相机标志
+	string mount;	//< 转台名称
+	bool ffov;		//< 是否为FFoV
+	bool based;		//< 是否给定名义基准
+	double rot0, tilt0;	//< 名义旋转与倾斜基准, 量纲: 角度
+
+public:
+	CameraRole() : ffov(false), based(false), rot0(0.0), tilt0(0.0) {}
+};
+typedef vector<CameraRole> CameraRoleV;
+
+class MountTopology {// 转台拓扑
+public:
+	/*!
+	 * @brief 加载拓扑配置文件
+	 * @param filepath 文件路径
+	 * @return
+	 * 文件可以打开且各行格式正确时返回true
+	 * @note
+	 * 原有配置被清除. 格式错误的行不被加载, 行号记入Errors()
+	 */
+	bool Load(const string& filepath);
+	/*!
+	 * @brief 查找相机角色
+	 * @param cid  相机标志
+	 * @param role 相机角色
+	 * @return
+	 * 确定相机角色时返回true
+	 * @note
+	 * 未加载配置时沿用缺省规则: cam_id前两位为转台, cam_id整数为5倍数对应FFoV.
+	 * 已加载配置时, 不在配置中的相机返回false
+	 */
+	bool Classify(const string& cid, CameraRole& role) const;
+	/*!
+	 * @brief 是否已加载配置
+	 */
+	bool Empty() const {
+		return roles_.empty();
+	}
+	/*!
+	 * @brief 格式错误的行号
+	 */
+	const vector<int>& Errors() const {
+		return errors_;
+	}
+
+protected:
+	CameraRoleV roles_;		//< 相机角色, 按cid升序排列
+	vector<int> errors_;	//< 格式错误的行号
+};
+
+#endif /* RELPOS_TOPOLOGY_H_ */